@@ -76,6 +76,65 @@ app.get("/pois", (req, res) => {
   }
 });
 
+// Simplified route written by PrettyPath next to the GPX. ?level=<tolerance>
+// keeps only the closest simplification level.
+app.get("/route", (req, res) => {
+  const config = JSON.parse(fs.readFileSync(configPath, "utf8"));
+  const filenames = config.filenames || {};
+  const routePath = path.join(
+    __dirname,
+    "..",
+    filenames.output_dir || "data/path/",
+    filenames.route || "route.json"
+  );
+  fs.readFile(routePath, "utf8", (err, data) => {
+    if (err) {
+      res.status(404).send("Route file not found");
+      return;
+    }
+    if (req.query.level === undefined) {
+      res.type("json").send(data);
+      return;
+    }
+    const route = JSON.parse(data);
+    const tolerance = parseFloat(req.query.level);
+    // A route with nothing to simplify, e.g. no tarns in reach, has no levels
+    if (!Array.isArray(route.levels) || route.levels.length === 0) {
+      res.json(route);
+      return;
+    }
+    route.levels = [
+      route.levels.reduce((best, level) =>
+        Math.abs(level.tolerance - tolerance) <
+        Math.abs(best.tolerance - tolerance)
+          ? level
+          : best
+      ),
+    ];
+    res.json(route);
+  });
+});
+
+// Outline of the area within reach of the start, written by PrettyPath next
+// to the route when a start location is set
+app.get("/isochrone", (req, res) => {
+  const config = JSON.parse(fs.readFileSync(configPath, "utf8"));
+  const filenames = config.filenames || {};
+  const isochronePath = path.join(
+    __dirname,
+    "..",
+    filenames.output_dir || "data/path/",
+    filenames.isochrone || "isochrone.json"
+  );
+  fs.readFile(isochronePath, "utf8", (err, data) => {
+    if (err) {
+      res.status(404).send("Isochrone file not found");
+      return;
+    }
+    res.type("json").send(data);
+  });
+});
+
 app.post("/tarns", (req, res) => {
   const tarns = req.body;
 
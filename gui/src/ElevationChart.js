@@ -10,7 +10,12 @@ import {
   ResponsiveContainer,
 } from "recharts";
 
-const ElevationChart = ({ data, setLocationPosition, setIsMarkerVisible }) => {
+const ElevationChart = ({
+  data,
+  stats,
+  setLocationPosition,
+  setIsMarkerVisible,
+}) => {
   const [closestPoint, setClosestPoint] = useState(null);
   const [isVisible, setIsVisible] = useState(true);
   const [totalElevationGain, setTotalElevationGain] = useState(0);
@@ -56,7 +61,13 @@ const ElevationChart = ({ data, setLocationPosition, setIsMarkerVisible }) => {
     setIsVisible(!isVisible);
   };
 
+  // Prefer the stats written with the route, they come from every track
+  // point rather than the simplified profile
   useEffect(() => {
+    if (stats) {
+      setTotalElevationGain(Math.round(stats.ascent));
+      return;
+    }
     const getTotalEleGain = () => {
       let totalEleGain = 0;
       for (let i = 0; i < data.length - 1; i++) {
@@ -67,7 +78,7 @@ const ElevationChart = ({ data, setLocationPosition, setIsMarkerVisible }) => {
       return totalEleGain;
     };
     setTotalElevationGain(getTotalEleGain());
-  }, [data]);
+  }, [data, stats]);
 
   return (
     <div className="absolute bottom-5 left-3 z-[100] w-3/4">
@@ -80,6 +91,12 @@ const ElevationChart = ({ data, setLocationPosition, setIsMarkerVisible }) => {
       {isVisible && (
         <div className="bg-white">
           <div>Total Elevation Gain: {totalElevationGain} meters</div>
+          {stats && (
+            <div>
+              Descent: {Math.round(stats.descent)} meters, walking time: about{" "}
+              {(stats.time / 3600).toFixed(1)} hours
+            </div>
+          )}
           <ResponsiveContainer width="100%" height={300}>
             <LineChart
               data={data}
@@ -19,10 +19,12 @@ import "leaflet.awesome-markers/dist/leaflet.awesome-markers.css";
 import "leaflet.awesome-markers";
 import { MapContext } from "./MapContext";
 import TarnLayer from "./TarnLayer";
+import IsochroneLayer from "./IsochroneLayer";
 import "leaflet.heightgraph";
 import "leaflet.heightgraph/dist/L.Control.Heightgraph.min.css";
 import Settings from "./Settings";
 import { parseElevationData } from "./parseElevationData";
+import { parseRouteElevation } from "./parseRoute";
 import ElevationChart, { LocationMarker } from "./ElevationChart";
 
 function MapBoundsUpdater({ setBounds }) {
@@ -87,6 +89,7 @@ function GPXLayer({
   setGpxLoaded,
   setStartLocation,
   setEleData,
+  setRouteStats,
 }) {
   const map = useMap();
 
@@ -182,8 +185,22 @@ function GPXLayer({
             }
           }
         });
-        const eleData = parseElevationData(e.target.getLayers());
-        setEleData(eleData);
+        // Prefer the simplified profile written next to the GPX, it is a
+        // fraction of the size of walking every track point
+        const layers = e.target.getLayers();
+        fetch("http://localhost:3001/route")
+          .then((response) => {
+            if (!response.ok) throw new Error(response.statusText);
+            return response.json();
+          })
+          .then((route) => {
+            setEleData(parseRouteElevation(route, colors));
+            setRouteStats(route.stats ? route.stats.total : null);
+          })
+          .catch(() => {
+            setEleData(parseElevationData(layers));
+            setRouteStats(null);
+          });
       })
       .on("error", function (e) {
         console.error("Error loading GPX file:", e);
@@ -197,6 +214,7 @@ function GPXLayer({
     setStartLocation,
     gpxHidden,
     setEleData,
+    setRouteStats,
   ]);
 
   return null;
@@ -235,6 +253,7 @@ export default function GPXMap({ gpxUrl }) {
   const [tarns, setTarns] = useState([]);
   const [unorderedTarns, setUnorderedTarns] = useState([]);
   const [eleData, setEleData] = useState([]);
+  const [routeStats, setRouteStats] = useState(null);
   const [locationMarkerPosition, setLocationMarkerPosition] = useState([0, 0]);
   const [isLocationMarkerVisible, setIsLocationMarkerVisible] = useState(false);
 
@@ -276,6 +295,7 @@ export default function GPXMap({ gpxUrl }) {
         />
         <ElevationChart
           data={eleData}
+          stats={routeStats}
           setLocationPosition={setLocationMarkerPosition}
           setIsMarkerVisible={setIsLocationMarkerVisible}
         />
@@ -296,8 +316,10 @@ export default function GPXMap({ gpxUrl }) {
             setGpxLoaded={setGpxLoaded}
             setStartLocation={setStartLocation}
             setEleData={setEleData}
+            setRouteStats={setRouteStats}
           />
 
+          <IsochroneLayer gpxLoaded={gpxLoaded} />
           <TarnLayer />
           <DraggableMarker
             position={startLocation}
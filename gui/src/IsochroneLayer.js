@@ -0,0 +1,40 @@
+import React, { useEffect, useState } from "react";
+import { Polygon, Tooltip } from "react-leaflet";
+import { decodePolyline } from "./parseRoute";
+
+// Area within reach of the start, tarns outside it were not routed to
+function IsochroneLayer({ gpxLoaded }) {
+  const [isochrone, setIsochrone] = useState(null);
+
+  useEffect(() => {
+    if (!gpxLoaded) return;
+    fetch("http://localhost:3001/isochrone")
+      .then((response) => {
+        if (!response.ok) throw new Error(response.statusText);
+        return response.json();
+      })
+      .then((data) =>
+        setIsochrone({
+          radius: data.radius,
+          positions: decodePolyline(data.polygon),
+        })
+      )
+      .catch(() => setIsochrone(null));
+  }, [gpxLoaded]);
+
+  if (!isochrone || isochrone.positions.length < 3) {
+    return null;
+  }
+  return (
+    <Polygon
+      positions={isochrone.positions}
+      pathOptions={{ color: "gray", weight: 1, fillOpacity: 0.08 }}
+    >
+      <Tooltip sticky>
+        Within {(isochrone.radius / 1000).toFixed(1)} km of the start
+      </Tooltip>
+    </Polygon>
+  );
+}
+
+export default IsochroneLayer;
@@ -0,0 +1,57 @@
+// Decode a Google encoded polyline into [lat, lon] pairs
+const decodePolyline = (encoded) => {
+  const points = [];
+  let index = 0;
+  let lat = 0;
+  let lon = 0;
+  while (index < encoded.length) {
+    const deltas = [0, 0];
+    for (let i = 0; i < 2; i++) {
+      let shift = 0;
+      let result = 0;
+      let byte;
+      do {
+        byte = encoded.charCodeAt(index++) - 63;
+        result |= (byte & 0x1f) << shift;
+        shift += 5;
+      } while (byte >= 0x20);
+      deltas[i] = result & 1 ? ~(result >> 1) : result >> 1;
+    }
+    lat += deltas[0];
+    lon += deltas[1];
+    points.push([lat / 1e5, lon / 1e5]);
+  }
+  return points;
+};
+
+// Elevation chart data from the route.json profile, in the same shape as
+// parseElevationData (distance in km, one segment per leg)
+const parseRouteElevation = (route, colors) => {
+  const profile = route.profile;
+  const locations = decodePolyline(profile.polyline);
+  const legStarts = route.waypoints.map((waypoint) => waypoint.distance);
+  const elevationData = [];
+  let segment_id = 0;
+
+  for (let i = 0; i < profile.distance.length; i++) {
+    const distance = profile.distance[i];
+    while (
+      segment_id + 2 < legStarts.length &&
+      distance > legStarts[segment_id + 1]
+    ) {
+      segment_id++;
+    }
+    elevationData.push({
+      distance: distance / 1000,
+      elevation: profile.elevation[i],
+      colour: colors[segment_id % colors.length],
+      segment_id: segment_id,
+      lat: locations[i][0],
+      lon: locations[i][1],
+    });
+  }
+
+  return elevationData;
+};
+
+export { decodePolyline, parseRouteElevation };
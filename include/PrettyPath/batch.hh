@@ -0,0 +1,17 @@
+#include <string>
+#include "config.hh"
+#pragma once
+
+// Runs many config variants against one loaded map. Each scenario is a JSON
+// merge patch over the base config with an optional "name"; scenarios run
+// concurrently, write their outputs to <output_dir><name>/ and are summarised
+// in <output_dir>batch_summary.csv of the base config.
+namespace Batch {
+
+// A thread count of 0 uses one thread per core. Returns false when the
+// scenarios could not be read or any scenario is invalid.
+bool run_scenarios(const nlohmann::json& base_config,
+                   const std::string& scenarios_filename,
+                   const size_t threads = 0);
+
+}  // namespace Batch
@@ -4,6 +4,32 @@
 #pragma once
 
 namespace Config {
+enum class SearchMode { AStar, Bidirectional };
+enum class QueueType { BinaryHeap, DaryHeap, RadixHeap };
+
+struct search_t {
+  size_t landmarks = 16;  // ALT landmarks, 0 disables
+  SearchMode mode = SearchMode::AStar;
+  QueueType queue = QueueType::DaryHeap;
+  // Heuristic weight, routes cost at most epsilon times the optimum. Above 1
+  // trades route quality for speed, e.g. for previews.
+  double epsilon = 1;
+};
+
+// Ascent, descent, grades and walking time written with the route
+struct route_stats_t {
+  double ascent_threshold = 0;  // m, smallest elevation change counted
+  // Grade bin edges in %, n edges make n + 1 bins
+  std::vector<double> grade_bins = {-20, -10, -5, -2, 2, 5, 10, 20};
+};
+
+// Simplified route written for the GUI alongside the GPX
+struct route_output_t {
+  std::vector<double> tolerances = {2, 8, 32, 128};  // m, one level each
+  double elevation_tolerance = 5;  // m, for the elevation profile
+  route_stats_t stats;
+};
+
 struct config_t {
   // Filenames
   std::string nodes_filename;
@@ -11,6 +37,11 @@ struct config_t {
   std::string tarns_filename;
   std::string output_dir;
   std::string gpx_filename;
+  std::string route_filename = "route.json";
+  // Area within reach of the start, written when there is a start location
+  std::string isochrone_filename = "isochrone.json";
+  // Tarn distances and tour kept between runs, empty disables
+  std::string matrix_cache_filename = "matrix_cache.json";
   // Cost
   float length_weight;
   float elevation_weight;
@@ -24,7 +55,7 @@ struct config_t {
   std::vector<std::string> tarn_blacklist;
   bool use_ordered_tarns = false;
   // Path Constraints
-  float max_path_length;  // TODO unused
+  float max_path_length;  // Tarns over half of it from the start are dropped
   float min_path_length;
   float max_elevation_gain;  // TODO unused
   int max_difficulty;
@@ -35,11 +66,54 @@ struct config_t {
   double max_latitude;
   double min_longitude;
   double max_longitude;
+  // Search
+  search_t search;
+  // Tour optimisation
+  unsigned int seed = 0;  // Annealer seed, 0 seeds from the clock
+  // Output
+  route_output_t route_output;
 };
 
 extern config_t c;
 
-inline void get_config(std::string config_filename) {
+// Overrides the fields of search given in a "search" section
+inline void get_search_config(const nlohmann::json& json, search_t& search) {
+  if (json.find("landmarks") != json.end())
+    search.landmarks = json["landmarks"];
+  if (json.find("mode") != json.end()) {
+    const std::string mode = json["mode"];
+    if (mode == "a_star") {
+      search.mode = SearchMode::AStar;
+    } else if (mode == "bidirectional") {
+      search.mode = SearchMode::Bidirectional;
+    } else {
+      std::cerr << "Unknown search mode: " << mode << std::endl;
+      exit(1);
+    }
+  }
+  if (json.find("epsilon") != json.end()) {
+    search.epsilon = json["epsilon"];
+    if (search.epsilon < 1) {
+      std::cerr << "Search epsilon must be at least 1" << std::endl;
+      exit(1);
+    }
+  }
+  if (json.find("queue") != json.end()) {
+    const std::string queue = json["queue"];
+    if (queue == "binary") {
+      search.queue = QueueType::BinaryHeap;
+    } else if (queue == "dary") {
+      search.queue = QueueType::DaryHeap;
+    } else if (queue == "radix") {
+      search.queue = QueueType::RadixHeap;
+    } else {
+      std::cerr << "Unknown search queue: " << queue << std::endl;
+      exit(1);
+    }
+  }
+}
+
+inline nlohmann::json read_config_file(const std::string& config_filename) {
   std::ifstream config_file(config_filename);
   if (!config_file.is_open()) {
     std::cerr << "Could not open config file" << std::endl;
@@ -48,13 +122,24 @@ inline void get_config(std::string config_filename) {
 
   nlohmann::json config;
   config_file >> config;
+  return config;
+}
 
+// Fills out from a parsed config file, optional fields it does not set keep
+// their current values
+inline void get_config(nlohmann::json config, config_t& out) {
   nlohmann::json filenames = config["filenames"];
-  c.nodes_filename = filenames["map_nodes"];
-  c.edges_filename = filenames["map_edges"];
-  c.tarns_filename = filenames["map_tarns"];
-  c.output_dir = filenames["output_dir"];
-  c.gpx_filename = filenames["gpx"];
+  out.nodes_filename = filenames["map_nodes"];
+  out.edges_filename = filenames["map_edges"];
+  out.tarns_filename = filenames["map_tarns"];
+  out.output_dir = filenames["output_dir"];
+  out.gpx_filename = filenames["gpx"];
+  if (filenames.find("route") != filenames.end())
+    out.route_filename = filenames["route"];
+  if (filenames.find("isochrone") != filenames.end())
+    out.isochrone_filename = filenames["isochrone"];
+  if (filenames.find("matrix_cache") != filenames.end())
+    out.matrix_cache_filename = filenames["matrix_cache"];
   nlohmann::json weights = config["path_cost"];
   if (weights.find("length_weight") == weights.end() ||
       weights.find("elevation_weight") == weights.end() ||
@@ -63,83 +148,115 @@ inline void get_config(std::string config_filename) {
     std::cerr << "Path cost weights not specified" << std::endl;
     exit(1);
   }
-  c.length_weight = weights["length_weight"];
-  c.elevation_weight = weights["elevation_weight"];
-  c.difficulty_weight = weights["difficulty_weight"];
-  c.cars_weight = weights["cars_weight"];
+  out.length_weight = weights["length_weight"];
+  out.elevation_weight = weights["elevation_weight"];
+  out.difficulty_weight = weights["difficulty_weight"];
+  out.cars_weight = weights["cars_weight"];
   nlohmann::json tarn_constraints = config["tarn_constraints"];
   if (tarn_constraints.find("use_ordered_tarns") != tarn_constraints.end())
-    c.use_ordered_tarns = tarn_constraints["use_ordered_tarns"];
+    out.use_ordered_tarns = tarn_constraints["use_ordered_tarns"];
   else {
-    c.min_tarn_elevation = tarn_constraints["min_elevation"];
-    c.max_tarn_elevation = tarn_constraints["max_elevation"];
-    c.min_tarn_area = tarn_constraints["min_area"];
-    c.max_tarn_area = tarn_constraints["max_area"];
+    out.min_tarn_elevation = tarn_constraints["min_elevation"];
+    out.max_tarn_elevation = tarn_constraints["max_elevation"];
+    out.min_tarn_area = tarn_constraints["min_area"];
+    out.max_tarn_area = tarn_constraints["max_area"];
     if (tarn_constraints.find("blacklist") != tarn_constraints.end()) {
       for (nlohmann::json::iterator it = tarn_constraints["blacklist"].begin();
            it != tarn_constraints["blacklist"].end(); ++it) {
-        c.tarn_blacklist.push_back(it.value());
+        out.tarn_blacklist.push_back(it.value());
       }
     }
   }
   nlohmann::json path_constraints = config["path_constraints"];
   // if(path_constraints != nullptr)
-  c.max_path_length = path_constraints["max_length"];
-  c.min_path_length = path_constraints["min_length"];
-  c.max_elevation_gain = path_constraints["max_elevation"];
-  c.max_difficulty = path_constraints["max_difficulty"];
-  c.max_cars = path_constraints["max_cars"];
+  out.max_path_length = path_constraints["max_length"];
+  out.min_path_length = path_constraints["min_length"];
+  out.max_elevation_gain = path_constraints["max_elevation"];
+  out.max_difficulty = path_constraints["max_difficulty"];
+  out.max_cars = path_constraints["max_cars"];
   if (path_constraints.find("start_location") != path_constraints.end())
-    c.start_location =
+    out.start_location =
         std::make_pair(path_constraints["start_location"]["latitude"],
                        path_constraints["start_location"]["longitude"]);
   nlohmann::json map_constraints = config["map_constraints"];
-  c.min_latitude = map_constraints["min_latitude"];
-  c.max_latitude = map_constraints["max_latitude"];
-  c.min_longitude = map_constraints["min_longitude"];
-  c.max_longitude = map_constraints["max_longitude"];
+  out.min_latitude = map_constraints["min_latitude"];
+  out.max_latitude = map_constraints["max_latitude"];
+  out.min_longitude = map_constraints["min_longitude"];
+  out.max_longitude = map_constraints["max_longitude"];
+  if (config.find("search") != config.end())
+    get_search_config(config["search"], out.search);
+  if (config.find("optimizer") != config.end()) {
+    nlohmann::json optimizer = config["optimizer"];
+    if (optimizer.find("seed") != optimizer.end())
+      out.seed = optimizer["seed"];
+  }
+  if (config.find("route_output") != config.end()) {
+    nlohmann::json route_output = config["route_output"];
+    if (route_output.find("tolerances") != route_output.end()) {
+      out.route_output.tolerances =
+          route_output["tolerances"].get<std::vector<double>>();
+    }
+    if (route_output.find("elevation_tolerance") != route_output.end())
+      out.route_output.elevation_tolerance =
+          route_output["elevation_tolerance"];
+    if (route_output.find("ascent_threshold") != route_output.end())
+      out.route_output.stats.ascent_threshold =
+          route_output["ascent_threshold"];
+    if (route_output.find("grade_bins") != route_output.end()) {
+      out.route_output.stats.grade_bins =
+          route_output["grade_bins"].get<std::vector<double>>();
+    }
+  }
+}
+
+inline void get_config(const std::string& config_filename) {
+  get_config(read_config_file(config_filename), c);
 }
 
-inline bool check_config() {
-  if (c.nodes_filename.empty()) {
+inline bool check_config(const config_t& config = c) {
+  if (config.nodes_filename.empty()) {
     std::cerr << "Nodes filename not specified" << std::endl;
     return false;
   }
-  if (c.edges_filename.empty()) {
+  if (config.edges_filename.empty()) {
     std::cerr << "Edges filename not specified" << std::endl;
     return false;
   }
-  if (c.tarns_filename.empty()) {
+  if (config.tarns_filename.empty()) {
     std::cerr << "Tarns filename not specified" << std::endl;
     return false;
   }
-  if (c.output_dir.empty()) {
+  if (config.output_dir.empty()) {
     std::cerr << "Path directory not specified" << std::endl;
     return false;
   }
-  if (c.gpx_filename.empty()) {
+  if (config.gpx_filename.empty()) {
     std::cerr << "GPX filename not specified" << std::endl;
     return false;
   }
-  if (c.min_path_length > c.max_path_length) {
+  if (config.route_filename.empty()) {
+    std::cerr << "Route filename not specified" << std::endl;
+    return false;
+  }
+  if (config.min_path_length > config.max_path_length) {
     std::cerr << "Minimum path length must be less than or equal to maximum "
                  "path length"
               << std::endl;
     return false;
   }
-  if (c.min_tarn_elevation > c.max_tarn_elevation) {
+  if (config.min_tarn_elevation > config.max_tarn_elevation) {
     std::cerr << "Minimum tarn elevation must be less than or equal to maximum "
                  "tarn elevation"
               << std::endl;
     return false;
   }
-  if (c.min_latitude > c.max_latitude) {
+  if (config.min_latitude > config.max_latitude) {
     std::cerr
         << "Minimum latitude must be less than or equal to maximum latitude"
         << std::endl;
     return false;
   }
-  if (c.min_longitude > c.max_longitude) {
+  if (config.min_longitude > config.max_longitude) {
     std::cerr
         << "Minimum longitude must be less than or equal to maximum longitude"
         << std::endl;
@@ -156,6 +273,11 @@ inline void print_config() {
   std::cout << "\t\tTarns filename: " << c.tarns_filename << std::endl;
   std::cout << "\t\tOutput directory: " << c.output_dir << std::endl;
   std::cout << "\t\tGPX filename: " << c.gpx_filename << std::endl;
+  std::cout << "\t\tRoute filename: " << c.route_filename << std::endl;
+  std::cout << "\t\tIsochrone filename: " << c.isochrone_filename
+            << std::endl;
+  std::cout << "\t\tMatrix cache filename: " << c.matrix_cache_filename
+            << std::endl;
   std::cout << "\tPath cost weights:" << std::endl;
   std::cout << "\t\tLength weight: " << c.length_weight << std::endl;
   std::cout << "\t\tElevation weight: " << c.elevation_weight << std::endl;
@@ -186,5 +308,34 @@ inline void print_config() {
   std::cout << "\t\tMaximum latitude: " << c.max_latitude << std::endl;
   std::cout << "\t\tMinimum longitude: " << c.min_longitude << std::endl;
   std::cout << "\t\tMaximum longitude: " << c.max_longitude << std::endl;
+  std::cout << "\tSearch:" << std::endl;
+  std::cout << "\t\tLandmarks: " << c.search.landmarks << std::endl;
+  std::cout << "\t\tMode: "
+            << (c.search.mode == SearchMode::Bidirectional ? "bidirectional"
+                                                           : "a_star")
+            << std::endl;
+  std::cout << "\t\tQueue: "
+            << (c.search.queue == QueueType::BinaryHeap ? "binary"
+                : c.search.queue == QueueType::RadixHeap ? "radix"
+                                                         : "dary")
+            << std::endl;
+  std::cout << "\t\tEpsilon: " << c.search.epsilon << std::endl;
+  std::cout << "\tOptimizer:" << std::endl;
+  std::cout << "\t\tSeed: " << c.seed << std::endl;
+  std::cout << "\tRoute output:" << std::endl;
+  std::cout << "\t\tTolerances:";
+  for (const double tolerance : c.route_output.tolerances) {
+    std::cout << " " << tolerance;
+  }
+  std::cout << " m" << std::endl;
+  std::cout << "\t\tElevation tolerance: "
+            << c.route_output.elevation_tolerance << " m" << std::endl;
+  std::cout << "\t\tAscent threshold: "
+            << c.route_output.stats.ascent_threshold << " m" << std::endl;
+  std::cout << "\t\tGrade bins:";
+  for (const double edge : c.route_output.stats.grade_bins) {
+    std::cout << " " << edge;
+  }
+  std::cout << " %" << std::endl;
 }
 }  // namespace Config
\ No newline at end of file
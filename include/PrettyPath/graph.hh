@@ -1,52 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "config.hh"
+#include "rtree.hh"
 #include "utils.hh"
 #pragma once
 
 using node_id_t = long;
+using node_index_t = uint32_t;  // Dense index of a node within the graph
 
+// Node ids, coordinates and elevations in structure of arrays form.
+// Coordinates are stored in 1e-7 degree fixed point, as in OSM, which
+// resolves about 1 cm.
+class NodeStore {
+ public:
+  node_index_t add(const node_id_t id, const double latitude,
+                   const double longitude, const float elevation) {
+    m_ids.push_back(id);
+    m_latitudes.push_back(std::lround(latitude * coordinate_scale));
+    m_longitudes.push_back(std::lround(longitude * coordinate_scale));
+    m_elevations.push_back(elevation);
+    return m_ids.size() - 1;
+  }
+
+  // Copy a node from another store without converting its coordinates
+  node_index_t add(const NodeStore& other, const node_index_t index) {
+    m_ids.push_back(other.m_ids[index]);
+    m_latitudes.push_back(other.m_latitudes[index]);
+    m_longitudes.push_back(other.m_longitudes[index]);
+    m_elevations.push_back(other.m_elevations[index]);
+    return m_ids.size() - 1;
+  }
+
+  void clear() {
+    m_ids = {};
+    m_latitudes = {};
+    m_longitudes = {};
+    m_elevations = {};
+  }
+
+  // Reorder the nodes by ascending id (stable), which find requires
+  void sort_by_id();
+
+  // Index of the first node with the given id in a store sorted by id, or
+  // size() if there is none
+  node_index_t find(const node_id_t id) const {
+    const auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if (it == m_ids.end() || *it != id) {
+      return m_ids.size();
+    }
+    return it - m_ids.begin();
+  }
+
+  size_t size() const { return m_ids.size(); }
+
+  size_t memory_usage() const {
+    return m_ids.capacity() * sizeof(node_id_t) +
+           (m_latitudes.capacity() + m_longitudes.capacity()) *
+               sizeof(int32_t) +
+           m_elevations.capacity() * sizeof(float);
+  }
+
+  node_id_t id(const node_index_t index) const { return m_ids[index]; }
+
+  double latitude(const node_index_t index) const {
+    return m_latitudes[index] / coordinate_scale;
+  }
+
+  double longitude(const node_index_t index) const {
+    return m_longitudes[index] / coordinate_scale;
+  }
+
+  float elevation(const node_index_t index) const {
+    return m_elevations[index];
+  }
+
+  static constexpr double coordinate_scale = 1e7;
+
+ private:
+  std::vector<node_id_t> m_ids;
+  std::vector<int32_t> m_latitudes, m_longitudes;
+  std::vector<float> m_elevations;
+};
+
+// Lightweight handle to a node in a NodeStore. A default constructed handle
+// refers to no node.
 class Node {
  public:
-  Node(size_t id, double latitude, double longitude, float elevation = 0)
-      : m_id(id),
-        m_latitude(latitude),
-        m_longitude(longitude),
-        m_elevation(elevation) {}
+  Node() = default;
+  Node(const NodeStore* store, const node_index_t index)
+      : m_store(store), m_index(index) {}
 
-  node_id_t get_id() const { return m_id; }
+  node_id_t get_id() const { return m_store->id(m_index); }
 
-  float get_elevation() const { return m_elevation; }
+  float get_elevation() const { return m_store->elevation(m_index); }
 
   std::pair<double, double> get_location() const {
-    return std::make_pair(m_latitude, m_longitude);
+    return std::make_pair(m_store->latitude(m_index),
+                          m_store->longitude(m_index));
+  }
+
+  const NodeStore* get_store() const { return m_store; }
+
+  node_index_t get_index() const { return m_index; }
+
+  bool operator==(const Node& other) const {
+    return m_store == other.m_store && m_index == other.m_index;
   }
 
-  bool operator==(const Node& other) const { return m_id == other.get_id(); }
+  bool operator!=(const Node& other) const { return !(*this == other); }
+
+  explicit operator bool() const { return m_store != nullptr; }
 
   double distance_to(double lat, double lon) const {
-    return utils::haversine_distance(m_latitude, m_longitude, lat, lon);
+    return utils::haversine_distance(m_store->latitude(m_index),
+                                     m_store->longitude(m_index), lat, lon);
   }
 
  private:
-  node_id_t m_id;
-  double m_latitude, m_longitude;
-  float m_elevation;
+  const NodeStore* m_store = nullptr;
+  node_index_t m_index = 0;
+};
+
+// Edge geometries packed into one byte pool. Each geometry is a varint node
+// count followed by the nodes' dense indices (into the parser's MapData) as
+// zig-zag varint deltas, so consecutive ids take a byte each.
+class GeometryPool {
+ public:
+  using offset_t = uint32_t;
+
+  // Decodes one geometry front to back
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = node_index_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const node_index_t*;
+    using reference = node_index_t;
+
+    Iterator(const uint8_t* data, const uint32_t remaining)
+        : m_data(data), m_remaining(remaining) {
+      if (m_remaining > 0) decode_next();
+    }
+
+    node_index_t operator*() const { return m_current; }
+
+    Iterator& operator++() {
+      if (--m_remaining > 0) decode_next();
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return m_remaining == other.m_remaining;
+    }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    void decode_next() {
+      const uint32_t zigzag = read_varint(m_data);
+      m_current += (zigzag >> 1) ^ -(zigzag & 1);
+    }
+
+    const uint8_t* m_data;
+    uint32_t m_remaining;
+    node_index_t m_current = 0;
+  };
+
+  class Geometry {
+   public:
+    explicit Geometry(const uint8_t* data) : m_data(data) {
+      m_size = read_varint(m_data);
+    }
+
+    Iterator begin() const { return Iterator(m_data, m_size); }
+    Iterator end() const { return Iterator(nullptr, 0); }
+    uint32_t size() const { return m_size; }
+
+   private:
+    const uint8_t* m_data;
+    uint32_t m_size;
+  };
+
+  offset_t add(const std::vector<node_index_t>& nodes) {
+    const offset_t offset = m_bytes.size();
+    write_varint(nodes.size());
+    node_index_t previous = 0;
+    for (const node_index_t node : nodes) {
+      const uint32_t delta = node - previous;  // Wraps for negative deltas
+      write_varint((delta << 1) ^ -(delta >> 31));
+      previous = node;
+    }
+    return offset;
+  }
+
+  Geometry get(const offset_t offset) const {
+    return Geometry(m_bytes.data() + offset);
+  }
+
+  size_t memory_usage() const { return m_bytes.capacity(); }
+
+ private:
+  void write_varint(uint32_t value) {
+    while (value >= 0x80) {
+      m_bytes.push_back(value | 0x80);
+      value >>= 7;
+    }
+    m_bytes.push_back(value);
+  }
+
+  static uint32_t read_varint(const uint8_t*& data) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      const uint8_t byte = *data++;
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) return value;
+    }
+  }
+
+  std::vector<uint8_t> m_bytes;
 };
 
 class Edge {
  public:
-  Edge(double length, double slope, int cars = 0, long osm_id = 0,
-       std::vector<long> edge_nodes = {})
-      : m_length(length),
-        m_slope(slope),
+  Edge(node_index_t source, node_index_t target, double length, float ascent,
+       float descent, int cars = 0, int difficulty = 0, long osm_id = 0,
+       GeometryPool::offset_t geometry = 0)
+      : m_osm_id(osm_id),
+        m_source(source),
+        m_target(target),
+        m_length(length),
+        m_ascent(ascent),
+        m_descent(descent),
         m_cars(cars),
-        m_osm_id(osm_id),
-        m_edge_nodes(edge_nodes) {}
+        m_difficulty(difficulty),
+        m_geometry(geometry) {}
 
   long get_osm_id() const { return m_osm_id; }
 
@@ -54,57 +250,202 @@ class Edge {
 
   int get_cars() const { return m_cars; }
 
-  void reverse_if_needed(node_id_t desired_source_id) {
-    if (desired_source_id == m_edge_nodes.front()) {
-      return;
+  GeometryPool::offset_t get_geometry() const { return m_geometry; }
+
+  // Endpoints as added to the graph, the geometry runs source to target
+  node_index_t get_source() const { return m_source; }
+
+  node_index_t get_target() const { return m_target; }
+
+  // The endpoint that is not node
+  node_index_t opposite(const node_index_t node) const {
+    return node == m_source ? m_target : m_source;
+  }
+
+  double get_length() const { return m_length; }
+
+  // Metres climbed and descended from source to target
+  float get_ascent() const { return m_ascent; }
+
+  float get_descent() const { return m_descent; }
+
+  // Walking effort of the hill in metres of flat ground: Naismith's rule
+  // (5 km/h plus an hour per 600 m climbed) with Langmuir's corrections,
+  // which make gentle descents faster and steep ones slower than the flat
+  double climb(const bool reversed) const {
+    const double up = reversed ? m_descent : m_ascent;
+    const double down = reversed ? m_ascent : m_descent;
+    const double grade = m_length > 0 ? down / m_length : 0;
+    double climb = naismith_ascent * up;
+    if (grade > steep_grade) {
+      climb += langmuir_descent * down;
+    } else if (grade > gentle_grade) {
+      climb -= langmuir_descent * down;
     }
-    std::reverse(m_edge_nodes.begin(), m_edge_nodes.end());
+    return climb;
   }
 
-  std::vector<node_id_t> get_edge_nodes() const { return m_edge_nodes; }
+  // Cost of walking the edge, from target to source when reversed
+  double cost(const Config::config_t& config,
+              const bool reversed = false) const {
+    const double cost = config.length_weight * m_length +
+                        config.elevation_weight * climb(reversed) +
+                        config.cars_weight * m_cars +
+                        config.difficulty_weight * m_difficulty;
+    return std::max(cost, 0.0);
+  }
 
-  double cost() const {
-    const double cost =
-        Config::c.length_weight * m_length +
-        Config::c.elevation_weight * (m_slope + 3) +  // TODO fix
-        Config::c.cars_weight * m_cars +
-        Config::c.difficulty_weight * m_difficulty;
-    return cost;
+  bool is_valid(const Config::config_t& config) const {
+    return m_difficulty <= config.max_difficulty && m_cars <= config.max_cars;
   }
 
-  double elevation_change() const { return m_length * m_slope; }
+  double elevation_change() const { return m_ascent - m_descent; }
+
+  // Flat metres per metre climbed (5 km per 600 m), and per metre descended
+  // (10 minutes per 300 m at 5 km/h)
+  static constexpr double naismith_ascent = 5000.0 / 600;
+  static constexpr double langmuir_descent = 5000.0 / 6 / 300;
+  // tan(5 deg) and tan(12 deg)
+  static constexpr double gentle_grade = 0.0875;
+  static constexpr double steep_grade = 0.2126;
 
  private:
-  long m_osm_id, m_source_id, m_target_id;
-  double m_length, m_slope;
+  long m_osm_id;
+  node_index_t m_source, m_target;
+  double m_length;
+  float m_ascent, m_descent;
   int m_cars, m_difficulty;
-  std::vector<node_id_t> m_edge_nodes;
+  GeometryPool::offset_t m_geometry;  // Offset into the graph's pool
+};
+
+using edge_index_t = uint32_t;  // Index of an edge within the graph
+
+// An edge traversed from source to target
+struct DirectedEdge {
+  edge_index_t edge;
+  node_index_t source, target;
+
+  DirectedEdge reversed() const { return {edge, target, source}; }
+};
+
+// A route as the sequence of edges it takes
+using path_t = std::vector<DirectedEdge>;
+
+// A location snapped onto an edge: the point fraction of the way along the
+// edge's geometry from its source, distance metres from the location
+struct snap_t {
+  edge_index_t edge = std::numeric_limits<edge_index_t>::max();
+  double fraction = 0;
+  float distance = 0;
+  float x = 0, y = 0;  // Projected position of the point
+
+  explicit operator bool() const {
+    return edge != std::numeric_limits<edge_index_t>::max();
+  }
 };
 
-// Store the graph as an adjacency list
-// The key is the node and the value is a vector of connecting nodes (node,
-// edge)
+// Store the graph as an adjacency list indexed by node index
+// Each entry is a vector of connecting (node index, edge index) pairs, the
+// edges themselves are stored once in the graph's edge list
 using graph_t =
-    std::unordered_map<const Node*,
-                       std::vector<std::pair<const Node*, const Edge>>>;
+    std::vector<std::vector<std::pair<node_index_t, edge_index_t>>>;
 
 class Graph {
  public:
   Graph() = default;
+  // Node handles point into the graph, so it must stay in place
+  Graph(const Graph&) = delete;
+  Graph& operator=(const Graph&) = delete;
 
-  void add_edge(const Node* node1, const Node* node2, const double length,
-                const double slope, const int cars = 0, const long osm_id = 0,
-                const std::vector<node_id_t> edge_nodes = {});
-  std::vector<const Node*> get_nodes() const;
-  void apply_to_nodes(std::function<void(const Node*)> func) const;
-  std::vector<std::pair<const Node*, const Edge>> get_neighbours(
-      const Node* node) const;
-  std::pair<const Node*, double> find_closest_node(
-      const double latitude, const double longitude) const;
+  void add_edge(const Node node1, const Node node2, const double length,
+                const float ascent, const float descent, const int cars = 0,
+                const int difficulty = 0, const long osm_id = 0,
+                const std::vector<node_index_t>& geometry = {});
+  std::vector<Node> get_nodes() const;
+  void apply_to_nodes(std::function<void(const Node)> func) const;
+  const std::vector<std::pair<node_index_t, edge_index_t>>& get_neighbours(
+      const node_index_t node) const {
+    return m_graph[node];
+  }
+  const std::vector<std::pair<node_index_t, edge_index_t>>& get_neighbours(
+      const Node node) const {
+    return m_graph[get_index(node)];
+  }
+  const Edge& get_edge(const edge_index_t index) const {
+    return m_edges[index];
+  }
+  // Dense MapData indices of the nodes along an edge, source to target
+  GeometryPool::Geometry get_geometry(const edge_index_t index) const {
+    return m_geometry.get(m_edges[index].get_geometry());
+  }
+  size_t geometry_memory_usage() const { return m_geometry.memory_usage(); }
+  size_t num_edges() const { return m_edges.size(); }
+  size_t num_nodes() const { return m_nodes.size(); }
+  node_index_t get_index(const Node node) const {
+    if (node.get_store() == &m_nodes) {
+      return node.get_index();
+    }
+    return m_node_index.at(node.get_id());
+  }
+  Node get_node(const node_index_t index) const {
+    return Node(&m_nodes, index);
+  }
+  std::pair<Node, double> find_closest_node(const double latitude,
+                                            const double longitude) const;
+  // Indexes the straight segments of every edge's geometry, whose nodes are
+  // read from geometry_nodes (the parser's MapData), for snap
+  void build_segment_index(const NodeStore& geometry_nodes);
+  size_t num_segments() const { return m_segments.size(); }
+  // The nearest point to a location on the edges accept allows, an empty
+  // snap when there is none
+  snap_t snap(const double latitude, const double longitude,
+              const std::function<bool(const edge_index_t)>& accept) const;
   void print_graph_info() const;
 
+  // Projection used for the cheap straight line distances below; set it
+  // (e.g. to the map bounds) before or after adding edges
+  void set_projection(const utils::LocalProjection& projection);
+  const utils::LocalProjection& get_projection() const { return m_projection; }
+  // Lower bound on the haversine distance between two nodes, in m
+  float projected_distance(const node_index_t node1,
+                           const node_index_t node2) const {
+    const float dx = m_x[node1] - m_x[node2];
+    const float dy = m_y[node1] - m_y[node2];
+    return std::sqrt(dx * dx + dy * dy);
+  }
+  std::pair<float, float> get_projected_location(
+      const node_index_t node) const {
+    return std::make_pair(m_x[node], m_y[node]);
+  }
+  float projected_distance(const node_index_t node, const float x,
+                           const float y) const {
+    const float dx = m_x[node] - x;
+    const float dy = m_y[node] - y;
+    return std::sqrt(dx * dx + dy * dy);
+  }
+  // Projected distance from a location to every node, by node index
+  std::vector<float> distances_from(const double latitude,
+                                    const double longitude) const;
+
  private:
+  node_index_t add_node(const Node node);
+
   graph_t m_graph;
+  std::vector<Edge> m_edges;
+  GeometryPool m_geometry;
+  NodeStore m_nodes;  // Nodes by dense index
+  std::unordered_map<node_id_t, node_index_t> m_node_index;
+  utils::LocalProjection m_projection;
+  std::vector<float, utils::AlignedAllocator<float>> m_x, m_y;  // Projected
+
+  struct segment_t {
+    float x1, y1, x2, y2;  // Projected, in the source to target direction
+    edge_index_t edge;
+    float offset;  // Projected length of the edge before the segment
+  };
+  std::vector<segment_t> m_segments;
+  std::vector<float> m_projected_lengths;  // Of each edge's geometry
+  PackedRTree<float> m_segment_tree;
 };
 
 struct POIData {
@@ -117,7 +458,7 @@ struct POIData {
         osm_id(osm_id),
         elevation(elevation),
         area(area) {}
-  std::string name_without_spaces() {
+  std::string name_without_spaces() const {
     std::string name_without_spaces = name;
     std::replace(name_without_spaces.begin(), name_without_spaces.end(), ' ',
                  '_');
@@ -127,6 +468,6 @@ struct POIData {
   double latitude, longitude;
   long osm_id;
   float elevation;
-  const Node* best_node = nullptr;
+  snap_t snap;  // Where routes join the graph, once snapped
   unsigned long area; // Only for tarns
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <utility>
+#include <vector>
+#include "config.hh"
+#include "graph.hh"
+#include "pathstore.hh"
+#include "profile.hh"
+#pragma once
+
+// Tarn to tarn route lengths, searched only when asked for. Until then a
+// pair is known by a lower bound, the straight line between its snapped
+// points, which the tour optimiser estimates the length from. Costs differ
+// by direction, so each pair is searched both ways and i to j may take
+// another route than j to i.
+class LazyMatrix {
+ public:
+  // The tarns must be snapped and outlive the matrix
+  LazyMatrix(const Graph& graph, const RoutingProfile& profile,
+             const std::vector<POIData>& tarns,
+             const Config::search_t& search);
+  // Every length known up front, e.g. from find_distances_between_tarns
+  LazyMatrix(const std::vector<double>& dist, const size_t n);
+
+  size_t size() const { return m_n; }
+  bool known(const int i, const int j) const { return m_known[i * m_n + j]; }
+  // The length when known
+  double lower_bound(const int i, const int j) const {
+    return m_lengths[i * m_n + j];
+  }
+  // Between the snapped points, the length for a matrix known up front
+  double straight_line(const int i, const int j) const {
+    return m_straight[i * m_n + j];
+  }
+  // Searches the pair when not known, max() when there is no path
+  double get(const int i, const int j);
+  // Searches the pairs not known yet concurrently
+  void prefetch(const std::vector<std::pair<int, int>>& pairs);
+  // A length found elsewhere, e.g. in the matrix cache
+  void set(const int i, const int j, const double length, const path_t& path);
+
+  // Paths of the known pairs
+  const PathStore& paths() const { return m_paths; }
+  size_t searches() const { return m_searches; }
+
+ private:
+  std::pair<double, path_t> search(const int i, const int j) const;
+
+  const Graph* m_graph = nullptr;
+  const RoutingProfile* m_profile = nullptr;
+  const std::vector<POIData>* m_tarns = nullptr;
+  Config::search_t m_search;
+  size_t m_n;
+  std::vector<double> m_lengths;  // Lower bounds until known
+  std::vector<double> m_straight;
+  std::vector<bool> m_known;
+  PathStore m_paths;
+  size_t m_searches = 0;
+};
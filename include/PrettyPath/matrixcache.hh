@@ -0,0 +1,47 @@
+#include <map>
+#include <string>
+#include "config.hh"
+#include "graph.hh"
+#include "profile.hh"
+#pragma once
+
+// Tarn to tarn distances and paths kept between runs, so a changed tarn set
+// only searches the pairs it has not seen, and the previous tour to warm
+// start the next one from. Entries are only reused by a run on the same
+// graph with the same profile and search settings.
+class MatrixCache {
+ public:
+  MatrixCache(const Graph& graph, const RoutingProfile& profile,
+              const Config::search_t& search);
+
+  // Missing or stale cache files leave the cache empty
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  // Path from one tarn to the other, false when that direction is not cached
+  bool find(const POIData& from, const POIData& to, double& distance,
+            path_t& path) const;
+  void insert(const POIData& from, const POIData& to, const double distance,
+              const path_t& path);
+  // Drops every pair with a tarn that is not in tarns
+  void retain(const std::vector<POIData>& tarns);
+  size_t size() const { return m_entries.size(); }
+
+  // Tarn keys in tour order
+  const std::vector<std::string>& get_tour() const { return m_tour; }
+  void set_tour(const std::vector<std::string>& tour) { m_tour = tour; }
+
+  // Tarns are identified by name and position, snapping depends on both
+  static std::string key(const POIData& tarn);
+
+ private:
+  struct entry_t {
+    double distance;
+    path_t path;  // From the first tarn of the key to the second
+  };
+
+  const Graph& m_graph;
+  uint64_t m_fingerprint;
+  std::map<std::pair<std::string, std::string>, entry_t> m_entries;
+  std::vector<std::string> m_tour;
+};
@@ -0,0 +1,54 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#pragma once
+
+// Process wide counters and phase timers. Counters live in per-thread slots
+// that only their own thread writes, so adding to one is an uncontended
+// relaxed store; totals are summed over every slot when read. A thread's
+// slot is reused by later threads once it exits.
+namespace Metrics {
+
+enum class Counter {
+  Queries,        // Searches run
+  NodesExpanded,  // Nodes popped and settled
+  EdgesRelaxed,   // Edges scanned out of settled nodes
+  QueuePushes,    // Inserts or key decreases in the open set
+  StalePops,      // Superseded queue entries discarded
+  Count
+};
+
+enum class Phase { Load, Snapping, Matrix, Optimization, Write, Count };
+
+void add(const Counter counter, const uint64_t value = 1);
+uint64_t total(const Counter counter);
+
+// Time spent in a phase, summed over all threads that entered it
+void add_time(const Phase phase, const std::chrono::nanoseconds time);
+double seconds(const Phase phase);
+uint64_t calls(const Phase phase);
+
+// Adds the lifetime of the scope to a phase
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const Phase phase)
+      : m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    add_time(m_phase, std::chrono::steady_clock::now() - m_start);
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Phase m_phase;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// Counts from zero again. Safe while searches run, what they add meanwhile
+// lands on one side of the reset or the other.
+void reset();
+std::string to_json();
+bool write_json(const std::string& filename);
+
+}  // namespace Metrics
@@ -1,10 +1,46 @@
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include "graph.hh"
+#include "metrics.hh"
+#include "pathfinder.hh"
+#include "poicatalogue.hh"
+#include "polyline.hh"
+#include "routestats.hh"
 #pragma once
 
-using MapData = std::unordered_map<long, const Node*>;  // Map node id to node
+// Every node read from the map, edge geometry included, in one contiguous
+// store sorted by OSM id. Ids map to dense indices with a binary search.
+class MapData {
+ public:
+  NodeStore& get_store() { return m_nodes; }
+
+  // Handle to the node with the given id, or a null handle
+  Node find(const node_id_t id) const {
+    const node_index_t index = m_nodes.find(id);
+    return index == m_nodes.size() ? Node() : Node(&m_nodes, index);
+  }
+
+  Node get_node(const node_index_t index) const {
+    return Node(&m_nodes, index);
+  }
+
+  Node at(const node_id_t id) const {
+    const Node node = find(id);
+    if (!node) {
+      throw std::out_of_range("Node " + std::to_string(id) + " not found");
+    }
+    return node;
+  }
+
+  size_t size() const { return m_nodes.size(); }
+
+  void clear() { m_nodes.clear(); }
+
+ private:
+  NodeStore m_nodes;
+};
 
 class Parser {
  public:
@@ -14,33 +50,50 @@ class Parser {
       const std::string& edge_nodes_string);
   static MapData read_map_data(Graph& graph);
   static std::vector<POIData> read_poi_data(const std::string& filename);
+  // Appends the rows of a POI csv to the catalogue, without building it
+  static void read_poi_catalogue(const std::string& filename,
+                                 const POIKind kind, POICatalogue& catalogue);
   static std::vector<POIData> read_ordered_poi_data(
       const std::string& filename);
-  static std::vector<std::pair<const long, const Node*>> path_to_node_list(
-      const MapData& map_data, const Graph& graph,
-      const std::vector<const Node*>& path);
-  static void write_path_to_py(
-      const std::vector<std::pair<const long, const Node*>>& node_list,
-      const std::string& filename);
-  static std::ofstream write_gpx_header(const std::string& file_name);
-  static void write_gpx_waypoint(std::ofstream& file, const std::string& name,
+  static std::vector<std::pair<const long, Node>> path_to_node_list(
+      const MapData& map_data, const Graph& graph, const path_t& path);
+  // Also feeds every node to stats, returns the length written
+  static double write_path_to_py(
+      const std::vector<std::pair<const long, Node>>& node_list,
+      std::string& csv, RouteStats::Accumulator& stats);
+  static void write_gpx_header(std::string& gpx);
+  static void write_gpx_waypoint(std::string& gpx, const std::string& name,
                                  const double lat, const double lon,
                                  const double elevation);
   static void write_gpx_track_segment(
-      std::ofstream& file, const std::string& name,
-      const std::vector<std::pair<const long, const Node*>>& node_list);
-  static void write_gpx_footer(std::ofstream& file);
+      std::string& gpx, const std::string& name,
+      const std::vector<std::pair<const long, Node>>& node_list);
+  static void write_gpx_footer(std::string& gpx);
+  static void write_route_json(
+      std::string& json, const Graph& graph,
+      const std::vector<std::pair<const POIData, size_t>>& pois,
+      const std::vector<Node>& route, const std::vector<size_t>& leg_starts,
+      const RouteStats::route_t& stats, const Config::route_output_t& options);
+  // Outline of the area within the isochrone's radius, for the GUI
+  static bool write_isochrone(const Graph& graph,
+                              const Pathfinder::isochrone_t& isochrone,
+                              const std::string& filename);
+  static bool write_file(const std::string& filename,
+                         const std::string& contents);
   //   static void write_path_to_gpx(
-  //       const std::vector<std::pair<const long, const Node*>>&
+  //       const std::vector<std::pair<const long, Node>>&
   //       full_node_list, const std::vector<std::tuple<std::string, const
   //       double, const double>>&
   //           tarn_nodes,
   //       const std::string& filename);
-  static void write_paths(
+  // Returns the stats of each leg and of the route, as written to its JSON
+  static RouteStats::route_t write_paths(
       const MapData& map_data, const Graph& graph,
-      const std::pair<std::vector<std::pair<const POIData, size_t>>,
-                      std::vector<const Node*>>& tarns_path,
-      const std::string& file_dir, const std::string& gpx_filename);
+      const std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>&
+          tarns_path,
+      const std::string& file_dir, const std::string& gpx_filename,
+      const std::string& route_filename,
+      const Config::route_output_t& route_output);
   static void clean_map_data(MapData& map_data);
 
  private:
@@ -1,39 +1,62 @@
-#include <queue>
-#include <stack>
-#include <unordered_set>
 #include "graph.hh"
+#include "metrics.hh"
+#include "profile.hh"
+#include "queue.hh"
+#pragma once
 
 namespace Pathfinder {
 
-using open_set_t =
-    std::priority_queue<std::pair<double, const Node*>,
-                        std::vector<std::pair<double, const Node*>>,
-                        std::greater<std::pair<double, const Node*>>>;
+// Predecessor edge of the start node in a came_from table
+const edge_index_t no_edge = std::numeric_limits<edge_index_t>::max();
+const node_index_t no_node = std::numeric_limits<node_index_t>::max();
 
-std::pair<double, const Node*> find_nearby_node(
-    const std::vector<const Node*> attempted_goals, const double variation,
-    const Graph& graph);
-std::pair<double, const Node*> find_nearby_connected_node(
-    const Node* const desired, const Node* connected_node,
-    const double variation, const Graph& graph);
-bool is_connected(const Graph& graph, const Node* start, const Node* goal);
-bool visit_next_node(const Graph& graph, std::stack<const Node*>& stack,
-                     std::unordered_set<const Node*>& visited_from_this_side,
-                     std::unordered_set<const Node*>& visited_from_other_side);
-std::vector<const Node*> reconstruct_path(
-    const std::unordered_map<const Node*, const Node*>& came_from,
-    const Node* current);
-void init(const Graph& graph, const Node* start, const Node* goal,
-          std::unordered_map<const Node*, const Node*>& came_from,
-          std::unordered_map<const Node*, double>& g_score,
-          std::unordered_map<const Node*, double>& f_score,
-          open_set_t& open_set);
-std::vector<const Node*> a_star(const Graph& graph, const Node*& start,
-                                const Node*& goal);
-bool find_connected_start_and_goal(const Graph& graph, const Node*& start,
-                                   const Node*& goal);
-void print_path(const std::vector<Node*>& path);
-double get_path_length(const std::vector<const Node*>& path);
-bool is_valid_edge(const Edge& edge);
+// A route between two snapped points: the whole edges from first to last,
+// with the partial edges to and from the points left out. first and last are
+// no_node when the route runs straight along the edge both points lie on.
+struct snapped_path_t {
+  bool found = false;
+  path_t path;
+  node_index_t first = no_node, last = no_node;
+};
+
+// Walking distances (m) from a snapped point to every node within radius of
+// it, max() beyond, for pruning what a route of bounded length can reach
+struct isochrone_t {
+  snap_t source;
+  double radius = 0;
+  std::vector<double> distances;
+
+  // Distance to a snapped point, max() when out of reach
+  double distance(const Graph& graph, const snap_t& snap) const;
+};
+
+path_t reconstruct_path(const Graph& graph,
+                        const std::vector<edge_index_t>& came_from,
+                        node_index_t current);
+double heuristic(const Graph& graph, const RoutingProfile& profile,
+                 const node_index_t node, const node_index_t goal);
+std::vector<double> dijkstra(
+    const Graph& graph, const RoutingProfile& profile, const Node source,
+    const double max_cost = std::numeric_limits<double>::max(),
+    const bool reverse = false);
+isochrone_t isochrone(const Graph& graph, const RoutingProfile& profile,
+                      const snap_t& source, const double radius);
+path_t find_path(const Graph& graph, const RoutingProfile& profile,
+                 const Node start, const Node goal,
+                 const Config::search_t& search = Config::c.search);
+snapped_path_t find_path(const Graph& graph, const RoutingProfile& profile,
+                         const snap_t& start, const snap_t& goal,
+                         const Config::search_t& search = Config::c.search);
+void reverse_path(path_t& path);
+void print_path(const Graph& graph, const path_t& path);
+double get_path_length(const Graph& graph, const path_t& path);
+// Includes the partial edges to and from the snapped points
+double get_path_length(const Graph& graph, const snapped_path_t& path,
+                       const snap_t& start, const snap_t& goal);
+// The route between two snapped points over these whole edges, as find_path
+// returns it. Without edges it joins the points' edges where they meet, or
+// runs along the edge both lie on. Not found when the edges do not meet.
+snapped_path_t join_snaps(const Graph& graph, path_t path,
+                          const snap_t& start, const snap_t& goal);
 
 }  // namespace Pathfinder
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include "graph.hh"
+#pragma once
+
+// Tarn to tarn paths packed into one byte pool, one per ordered pair of
+// tarns, as costs differ by direction. Each edge takes a byte: its position
+// among the neighbours of the node it leaves in the high nibble and of the
+// node it reaches in the low one. An edge at position 15 or later is written
+// out instead, as its id after a 0xff byte, which no packed byte can be.
+class PathStore {
+ public:
+  // Decodes one path front to back
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = DirectedEdge;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const DirectedEdge*;
+    using reference = DirectedEdge;
+
+    Iterator(const Graph* graph, const uint8_t* data, const uint32_t remaining,
+             const node_index_t node)
+        : m_graph(graph), m_data(data), m_remaining(remaining) {
+      m_current.target = node;
+      if (m_remaining > 0) decode_next();
+    }
+
+    DirectedEdge operator*() const { return m_current; }
+
+    Iterator& operator++() {
+      if (--m_remaining > 0) decode_next();
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return m_remaining == other.m_remaining;
+    }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    void decode_next() {
+      const node_index_t source = m_current.target;
+      const uint8_t byte = *m_data;
+      if (byte != escape) {
+        const auto& next = m_graph->get_neighbours(source)[byte >> 4];
+        m_current = {next.second, source, next.first};
+        m_data++;
+        return;
+      }
+      const edge_index_t edge = read_edge(m_data + 1);
+      m_data += escaped_bytes;
+      const Edge& next = m_graph->get_edge(edge);
+      m_current = {edge, source,
+                   next.get_source() == source ? next.get_target()
+                                               : next.get_source()};
+    }
+
+    const Graph* m_graph;
+    const uint8_t* m_data;  // The next edge
+    uint32_t m_remaining;
+    DirectedEdge m_current = {0, 0, 0};
+  };
+
+  class Path {
+   public:
+    Path(const Graph& graph, const uint8_t* data, const uint32_t size,
+         const node_index_t source)
+        : m_graph(&graph), m_data(data), m_size(size), m_source(source) {}
+
+    Iterator begin() const {
+      return Iterator(m_graph, m_data, m_size, m_source);
+    }
+    Iterator end() const { return Iterator(nullptr, nullptr, 0, 0); }
+    DirectedEdge front() const { return *begin(); }
+    uint32_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+   private:
+    const Graph* m_graph;
+    const uint8_t* m_data;
+    uint32_t m_size;
+    node_index_t m_source;  // Where the path starts
+  };
+
+  // Room for the pairs of this many tarns up front
+  explicit PathStore(const size_t tarns = 0)
+      : m_index(tarns * (tarns - 1), no_entry) {}
+
+  // Path from tarn i to tarn j, which has to be stored. Adding a path may
+  // move the pool, leaving the paths got before it invalid.
+  Path get(const Graph& graph, const int i, const int j) const;
+  bool contains(const int i, const int j) const;
+  // Replaces the path from tarn i to tarn j
+  void add(const Graph& graph, const int i, const int j, const path_t& path);
+
+  // Pairs stored
+  size_t size() const { return m_entries.size(); }
+  size_t memory_usage() const;
+
+ private:
+  static constexpr uint8_t escape = 0xff;
+  static constexpr uint32_t escaped_bytes = 1 + sizeof(edge_index_t);
+  static constexpr uint32_t no_entry = UINT32_MAX;
+
+  struct entry_t {
+    uint32_t offset;  // Into the pool
+    uint32_t size;    // Edges
+    node_index_t source;
+  };
+
+  // Pairs in order of the higher tarn, then the lower, then from the lower
+  // tarn before from the higher
+  static size_t key(const int i, const int j) {
+    const size_t low = std::min(i, j), high = std::max(i, j);
+    return 2 * (high * (high - 1) / 2 + low) + (i > j);
+  }
+  static edge_index_t read_edge(const uint8_t* data) {
+    edge_index_t edge = 0;
+    for (size_t i = 0; i < sizeof(edge_index_t); i++) {
+      edge |= static_cast<edge_index_t>(data[i]) << (8 * i);
+    }
+    return edge;
+  }
+  void write_edge(const Graph& graph, const DirectedEdge& edge);
+
+  std::vector<uint8_t> m_bytes;
+  std::vector<entry_t> m_entries;
+  std::vector<uint32_t> m_index;  // Entry of each pair, no_entry if none
+};
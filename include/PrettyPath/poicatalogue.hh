@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "graph.hh"
+#include "rtree.hh"
+#pragma once
+
+enum class POIKind : uint8_t { Tarn, Peak };
+
+struct poi_query_t {
+  double min_latitude = -90, max_latitude = 90;
+  double min_longitude = -180, max_longitude = 180;
+  double min_elevation = std::numeric_limits<double>::lowest();
+  double max_elevation = std::numeric_limits<double>::max();
+  double min_area = 0;
+  double max_area = std::numeric_limits<double>::max();
+  uint8_t kinds = 0xff;  // Bit per POIKind
+  // Indexed by name id, from POICatalogue::name_mask
+  const std::vector<bool>* blacklist = nullptr;
+};
+
+// Points of interest stored column by column, with names interned and a
+// packed R-tree over positions. Attribute columns also keep a sorted order,
+// so a query scans whichever of the bbox, elevation or area ranges holds the
+// fewest POIs.
+class POICatalogue {
+ public:
+  POICatalogue() = default;
+  // Interned names are looked up through views into m_names
+  POICatalogue(const POICatalogue&) = delete;
+  POICatalogue& operator=(const POICatalogue&) = delete;
+  POICatalogue(POICatalogue&&) = default;
+
+  void add(const POIData& poi, const POIKind kind);
+  // Builds the indices, call after the last add and before querying
+  void build();
+
+  size_t size() const { return m_latitude.size(); }
+  POIData get(const uint32_t index) const;
+  const std::string& name(const uint32_t index) const {
+    return m_names[m_name[index]];
+  }
+
+  // Mask over name ids set for the given names, names the catalogue does not
+  // hold are ignored
+  std::vector<bool> name_mask(const std::vector<std::string>& names) const;
+
+  // Calls visit(index) for every POI matching the query, in no particular
+  // order and without allocating
+  template <typename F>
+  void query(const poi_query_t& query, F&& visit) const {
+    const auto matches = [&](const uint32_t i) {
+      return m_latitude[i] >= query.min_latitude &&
+             m_latitude[i] <= query.max_latitude &&
+             m_longitude[i] >= query.min_longitude &&
+             m_longitude[i] <= query.max_longitude &&
+             m_elevation[i] >= query.min_elevation &&
+             m_elevation[i] <= query.max_elevation &&
+             m_area[i] >= query.min_area && m_area[i] <= query.max_area &&
+             (query.kinds >> static_cast<int>(m_kind[i]) & 1) &&
+             !(query.blacklist != nullptr && (*query.blacklist)[m_name[i]]);
+    };
+
+    const auto elevations =
+        std::make_pair(std::lower_bound(m_sorted_elevation.begin(),
+                                        m_sorted_elevation.end(),
+                                        query.min_elevation),
+                       std::upper_bound(m_sorted_elevation.begin(),
+                                        m_sorted_elevation.end(),
+                                        query.max_elevation));
+    const auto areas = std::make_pair(
+        std::lower_bound(m_sorted_area.begin(), m_sorted_area.end(),
+                         query.min_area),
+        std::upper_bound(m_sorted_area.begin(), m_sorted_area.end(),
+                         query.max_area));
+    const long num_elevations = elevations.second - elevations.first;
+    const long num_areas = areas.second - areas.first;
+    if (num_elevations <= 0 || num_areas <= 0) {
+      return;
+    }
+
+    const long num_in_bbox = estimate_in_bbox(query);
+    if (num_in_bbox <= num_elevations && num_in_bbox <= num_areas) {
+      m_tree.query({query.min_longitude, query.min_latitude,
+                    query.max_longitude, query.max_latitude},
+                   [&](const uint32_t i) {
+                     if (matches(i)) visit(i);
+                   });
+      return;
+    }
+    const bool by_elevation = num_elevations <= num_areas;
+    const std::vector<uint32_t>& order =
+        by_elevation ? m_by_elevation : m_by_area;
+    const long first =
+        by_elevation ? elevations.first - m_sorted_elevation.begin()
+                     : areas.first - m_sorted_area.begin();
+    const long last = first + (by_elevation ? num_elevations : num_areas);
+    for (long i = first; i < last; i++) {
+      if (matches(order[i])) visit(order[i]);
+    }
+  }
+
+  // Matching POIs in the order they were added
+  std::vector<POIData> select(const poi_query_t& query) const;
+
+ private:
+  // POIs expected inside the query bbox if they were spread evenly over the
+  // bounds of the catalogue
+  long estimate_in_bbox(const poi_query_t& query) const;
+
+  // Interned names, the deque keeps the views in m_name_ids valid
+  std::deque<std::string> m_names;
+  std::unordered_map<std::string_view, uint32_t> m_name_ids;
+
+  std::vector<uint32_t> m_name;
+  std::vector<double> m_latitude, m_longitude;
+  std::vector<float> m_elevation;
+  std::vector<unsigned long> m_area;
+  std::vector<POIKind> m_kind;
+  std::vector<long> m_osm_id;
+
+  // POIs sorted by elevation and by area, with the sorted values alongside
+  std::vector<uint32_t> m_by_elevation, m_by_area;
+  std::vector<float> m_sorted_elevation;
+  std::vector<unsigned long> m_sorted_area;
+
+  PackedRTree<double> m_tree;  // Longitude as x, latitude as y
+  PackedRTree<double>::box_t m_bounds;
+};
@@ -1,5 +1,10 @@
 #include "graph.hh"
+#include "lazymatrix.hh"
+#include "matrixcache.hh"
 #include "pathfinder.hh"
+#include "pathstore.hh"
+#include "poicatalogue.hh"
+#include "profile.hh"
 
 namespace TarnRouter {
 std::vector<POIData> filter_tarns(
@@ -8,33 +13,66 @@ std::vector<POIData> filter_tarns(
     const double min_latitude, const double max_latitude,
     const double min_longitude, const double max_longitude,
     const std::vector<std::string>& blacklist);
-std::pair<double, std::vector<const Node*>> find_path_between_tarns(
-    const Graph& graph, POIData& tarn1, POIData& tarn2);
+// Tarns of the catalogue within the configured bounds, elevations and areas
+// and off the blacklist, in catalogue order
+std::vector<POIData> select_tarns(const POICatalogue& catalogue,
+                                  const Config::config_t& config = Config::c);
+std::pair<double, path_t> find_path_between_tarns(
+    const Graph& graph, const RoutingProfile& profile, POIData& tarn1,
+    POIData& tarn2, const Config::search_t& search = Config::c.search);
 double calculate_total_distance(const std::vector<int>& path,
                                 const std::vector<double>& dist, const int n,
                                 const double min_dist, const double max_dist);
-std::vector<int> route_unordered_tarns(const std::vector<double>& dist,
-                                       const int n, const double min_dist,
-                                       const double max_dist);
-std::pair<std::vector<double>,
-          std::unordered_map<int, std::vector<const Node*>>>
-find_distances_between_tarns(const Graph& graph, std::vector<POIData>& tarns);
+// A seed of 0 seeds the annealer from the clock. A tour of all n stops
+// starting at 0 is refined instead of starting over.
+std::vector<int> route_unordered_tarns(
+    const std::vector<double>& dist, const int n, const double min_dist,
+    const double max_dist, const unsigned int seed = 0,
+    const std::vector<int>& initial_path = {});
+// Anneals on the known lengths and estimates of the rest, then searches the
+// legs of the tour found and refines it, until its legs were all known
+std::vector<int> route_unordered_tarns(
+    LazyMatrix& matrix, const double min_dist, const double max_dist,
+    const unsigned int seed = 0, const std::vector<int>& initial_path = {});
+std::pair<std::vector<double>, PathStore> find_distances_between_tarns(
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarns,
+    const Config::search_t& search = Config::c.search,
+    MatrixCache* cache = nullptr);
 void print_table(const std::vector<double>& table,
                  const std::vector<std::string>& names);
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
-reconstruct_path(const std::vector<POIData>& tarns,
-                 std::unordered_map<int, std::vector<const Node*>>& paths,
-                 const int n, const std::vector<int>& index_path);
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
+// Legs hold the whole edges between the tarns, the partial edges to each
+// tarn's snapped point are left to the writer
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
+reconstruct_path(const Graph& graph, const std::vector<POIData>& tarns,
+                 const PathStore& paths, const std::vector<int>& index_path);
+// Length of a route as the matrix measures its legs, with the partial edges
+// to and from each tarn's snapped point
+double get_route_length(
+    const Graph& graph,
+    const std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>&
+        route);
+// Drops the tarns after the first (the start) that are further than radius
+// from it, walking the graph, and returns the isochrone it measured that on
+Pathfinder::isochrone_t drop_unreachable_tarns(const Graph& graph,
+                                               const RoutingProfile& profile,
+                                               std::vector<POIData>& tarns,
+                                               const double radius);
+// With a start location, tarns out of reach of it are dropped before the
+// matrix is searched, and the isochrone is kept when asked for
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
 find_shortest_path_between_tarns(
-    const Graph& graph, std::vector<POIData>& tarn, const double min_dist,
-    const double max_dist,
-    const std::pair<double, double>& start_location = {0, 0});
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarn, const double min_dist, const double max_dist,
+    const std::pair<double, double>& start_location = {0, 0},
+    const unsigned int seed = 0,
+    const Config::search_t& search = Config::c.search,
+    MatrixCache* cache = nullptr,
+    Pathfinder::isochrone_t* isochrone = nullptr);
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
 find_shortest_path_between_ordered_tarns(
-    const Graph& graph, std::vector<POIData>& tarn,
-    const std::pair<double, double>& start_location = {0, 0});
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarn,
+    const std::pair<double, double>& start_location = {0, 0},
+    const Config::search_t& search = Config::c.search);
 }  // namespace TarnRouter
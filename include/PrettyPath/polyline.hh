@@ -0,0 +1,20 @@
+#include <string>
+#include <utility>
+#include <vector>
+#pragma once
+
+namespace Polyline {
+
+// Douglas-Peucker simplification of a planar line. Returns the indices of the
+// points kept, always including the first and last, such that no dropped
+// point is further than tolerance from the simplified line.
+std::vector<size_t> simplify(const std::vector<std::pair<float, float>>& points,
+                             const double tolerance);
+
+// Append (lat, lon) points in Google's encoded polyline format (1e-5 degree
+// precision). The output uses the characters '?' to '~', so a backslash has
+// to be escaped when it is embedded in a JSON string.
+void encode(std::string& buffer,
+            const std::vector<std::pair<double, double>>& locations);
+
+}  // namespace Polyline
@@ -0,0 +1,123 @@
+#include <limits>
+#include <vector>
+#include "config.hh"
+#include "graph.hh"
+#include "utils.hh"
+#pragma once
+
+class RoutingProfile;
+
+// ALT (A*, Landmarks, Triangle inequality) lower bounds on path cost.
+// Costs differ by direction, so the distances both from and to every
+// landmark are stored node-major as floats, and a heuristic evaluation reads
+// one contiguous row for the node and the goal.
+class Landmarks {
+ public:
+  Landmarks() = default;
+
+  void build(const Graph& graph, const RoutingProfile& profile,
+             const size_t count);
+
+  size_t size() const { return m_landmarks.size(); }
+
+  // Lower bound on the cost from node to goal
+  double lower_bound(const node_index_t node, const node_index_t goal) const {
+    return lower_bound(row(node), row(goal));
+  }
+
+  // Distances from and to every landmark of a node, as used by lower_bound
+  const float* row(const node_index_t node) const {
+    return m_distances.data() + node * 2 * m_landmarks.size();
+  }
+
+  // Row of a point off the graph that is reached from nodes[i] at cost
+  // costs_from[i] and reaches it at costs_to[i], so every path to or from a
+  // landmark passes one of the nodes
+  std::vector<float> virtual_row(const node_index_t* nodes,
+                                 const double* costs_to,
+                                 const double* costs_from,
+                                 const size_t count) const;
+
+  double lower_bound(const float* from, const float* to) const {
+    const size_t count = m_landmarks.size();
+    float bound = 0;
+    for (size_t i = 0; i < 2 * count; i += 2) {
+      // d(L, goal) <= d(L, node) + d(node, goal)
+      if (from[i] != unreachable && to[i] != unreachable &&
+          to[i] - from[i] > bound) {
+        bound = to[i] - from[i];
+      }
+      // d(node, L) <= d(node, goal) + d(goal, L)
+      if (from[i + 1] != unreachable && to[i + 1] != unreachable &&
+          from[i + 1] - to[i + 1] > bound) {
+        bound = from[i + 1] - to[i + 1];
+      }
+    }
+    return bound;
+  }
+
+  static constexpr float unreachable = std::numeric_limits<float>::max();
+
+ private:
+  std::vector<node_index_t> select_landmarks(const Graph& graph,
+                                             const RoutingProfile& profile,
+                                             const size_t count) const;
+
+  std::vector<node_index_t> m_landmarks;
+  // m_distances[node * 2 * size() + 2 * landmark] from the landmark to the
+  // node, and + 1 from the node to the landmark
+  std::vector<float> m_distances;
+};
+
+// Path cost weights and constraints compiled into two flat costs per edge,
+// one for each direction of travel, so a search relaxation is a couple of
+// array loads. Edges excluded by the constraints are marked as blocked.
+class RoutingProfile {
+ public:
+  RoutingProfile(const Graph& graph, const Config::config_t& config);
+
+  // Cost of walking along edge away from the node from
+  double cost(const edge_index_t edge, const node_index_t from) const {
+    return m_costs[2 * edge + (from != m_sources[edge])];
+  }
+
+  bool is_blocked(const edge_index_t edge) const {
+    return m_costs[2 * edge] == blocked;
+  }
+
+  // Lowest cost per metre of any open edge in either direction, so scaling
+  // a distance by it never overestimates the cost of covering it
+  double min_cost_per_metre() const { return m_min_cost_per_metre; }
+
+  void build_landmarks(const Graph& graph, const size_t count) {
+    m_landmarks.build(graph, *this, count);
+  }
+
+  const Landmarks& get_landmarks() const { return m_landmarks; }
+
+  // Connected component of a node over the open edges. Edges are open in
+  // both directions or neither, so nodes of a component reach each other.
+  uint32_t component(const node_index_t node) const {
+    return m_components[node];
+  }
+  uint32_t main_component() const { return m_main_component; }
+  size_t main_component_size() const { return m_main_component_size; }
+
+  // The nearest point to a location on an open edge of the main component
+  snap_t snap(const Graph& graph, const double latitude,
+              const double longitude) const;
+
+  // Stands in for infinity: -ffast-math lets the compiler assume real
+  // infinities never occur, so comparisons against one are not reliable
+  static constexpr float blocked = std::numeric_limits<float>::max();
+
+ private:
+  // m_costs[2 * edge] from source to target, m_costs[2 * edge + 1] back
+  std::vector<float, utils::AlignedAllocator<float>> m_costs;
+  std::vector<node_index_t> m_sources;
+  double m_min_cost_per_metre = 0;
+  Landmarks m_landmarks;
+  std::vector<uint32_t> m_components;
+  uint32_t m_main_component = 0;
+  size_t m_main_component_size = 0;
+};
@@ -0,0 +1,303 @@
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "graph.hh"
+#pragma once
+
+// Priority queues for the searches. All of them share one interface over
+// dense node indices:
+//   push(node, key)  insert node, or lower its key if already queued
+//   pop()            remove and return the node with the smallest key
+//   top_key()        smallest key currently queued
+//   empty()
+//   stale_pops()     superseded entries discarded so far
+// A node is never handed out twice with the same key, so callers do not have
+// to detect stale entries themselves.
+namespace Queue {
+
+// std::priority_queue with lazy duplicates. Superseded entries are dropped
+// when they reach the top.
+class BinaryHeap {
+ public:
+  explicit BinaryHeap(const size_t num_nodes)
+      : m_keys(num_nodes, std::numeric_limits<double>::max()) {}
+
+  void push(const node_index_t node, const double key) {
+    if (key >= m_keys[node]) {
+      return;
+    }
+    m_keys[node] = key;
+    m_heap.push(std::make_pair(key, node));
+  }
+
+  node_index_t pop() {
+    skip_stale();
+    const node_index_t node = m_heap.top().second;
+    m_heap.pop();
+    m_keys[node] = std::numeric_limits<double>::lowest();  // Popped
+    return node;
+  }
+
+  double top_key() {
+    skip_stale();
+    return m_heap.top().first;
+  }
+
+  bool empty() {
+    skip_stale();
+    return m_heap.empty();
+  }
+
+  size_t stale_pops() const { return m_stale; }
+
+ private:
+  void skip_stale() {
+    while (!m_heap.empty() &&
+           m_heap.top().first != m_keys[m_heap.top().second]) {
+      m_heap.pop();
+      m_stale++;
+    }
+  }
+
+  std::priority_queue<std::pair<double, node_index_t>,
+                      std::vector<std::pair<double, node_index_t>>,
+                      std::greater<std::pair<double, node_index_t>>>
+      m_heap;
+  std::vector<double> m_keys;  // Current key of each node
+  size_t m_stale = 0;
+};
+
+// Indexed d-ary min heap with decrease-key, so each node is in the heap at
+// most once. A 4-ary heap is shallower than a binary one and its children
+// share a cache line.
+template <size_t D = 4>
+class DaryHeap {
+ public:
+  explicit DaryHeap(const size_t num_nodes)
+      : m_position(num_nodes, not_queued) {}
+
+  void push(const node_index_t node, const double key) {
+    uint32_t position = m_position[node];
+    if (position == popped) {
+      return;
+    }
+    if (position == not_queued) {
+      position = m_heap.size();
+      m_heap.push_back(std::make_pair(key, node));
+    } else if (key < m_heap[position].first) {
+      m_heap[position].first = key;
+    } else {
+      return;
+    }
+    sift_up(position);
+  }
+
+  node_index_t pop() {
+    const node_index_t node = m_heap.front().second;
+    m_position[node] = popped;
+    m_heap.front() = m_heap.back();
+    m_heap.pop_back();
+    if (!m_heap.empty()) {
+      sift_down(0);
+    }
+    return node;
+  }
+
+  double top_key() const { return m_heap.front().first; }
+
+  bool empty() const { return m_heap.empty(); }
+
+  size_t stale_pops() const { return 0; }  // Keys are decreased in place
+
+ private:
+  void sift_up(uint32_t position) {
+    const auto entry = m_heap[position];
+    while (position > 0) {
+      const uint32_t parent = (position - 1) / D;
+      if (m_heap[parent].first <= entry.first) {
+        break;
+      }
+      place(position, m_heap[parent]);
+      position = parent;
+    }
+    place(position, entry);
+  }
+
+  void sift_down(uint32_t position) {
+    const auto entry = m_heap[position];
+    const size_t size = m_heap.size();
+    while (true) {
+      const size_t first_child = D * position + 1;
+      if (first_child >= size) {
+        break;
+      }
+      const size_t last_child = std::min(first_child + D, size);
+      size_t best = first_child;
+      for (size_t child = first_child + 1; child < last_child; child++) {
+        if (m_heap[child].first < m_heap[best].first) best = child;
+      }
+      if (entry.first <= m_heap[best].first) {
+        break;
+      }
+      place(position, m_heap[best]);
+      position = best;
+    }
+    place(position, entry);
+  }
+
+  void place(const uint32_t position,
+             const std::pair<double, node_index_t>& entry) {
+    m_heap[position] = entry;
+    m_position[entry.second] = position;
+  }
+
+  static constexpr uint32_t not_queued = std::numeric_limits<uint32_t>::max();
+  static constexpr uint32_t popped = not_queued - 1;
+
+  std::vector<std::pair<double, node_index_t>> m_heap;
+  std::vector<uint32_t> m_position;  // Heap slot of each node
+};
+
+// Monotone radix heap over keys quantized to integers. Valid when no key
+// pushed is below the last key popped, which holds for Dijkstra and for A*
+// with a consistent heuristic. Keys are stored relative to the smallest key
+// pushed before the first pop (so they may be negative, as in the
+// bidirectional search, and a search may start from several nodes in any
+// order) and are clamped to the last popped key to absorb floating point
+// rounding. Order is exact up to one quantum (1 / scale).
+class RadixHeap {
+ public:
+  explicit RadixHeap(const size_t num_nodes, const double scale = 1000)
+      : m_keys(num_nodes, unset), m_scale(scale) {}
+
+  void push(const node_index_t node, const double key) {
+    if (m_keys[node] == popped) {
+      return;
+    }
+    if (m_empty_since_start) {
+      m_base = key;
+      m_empty_since_start = false;
+    } else if (key < m_base && !m_popped) {
+      rebase(key);
+    }
+    uint64_t quantized =
+        key > m_base ? static_cast<uint64_t>((key - m_base) * m_scale) : 0;
+    if (quantized < m_last) quantized = m_last;
+    if (quantized >= m_keys[node]) {
+      return;
+    }
+    m_keys[node] = quantized;
+    m_buckets[bucket(quantized)].push_back(std::make_pair(quantized, node));
+    m_size++;
+  }
+
+  node_index_t pop() {
+    refill();
+    const node_index_t node = m_buckets[0].back().second;
+    m_buckets[0].pop_back();
+    m_size--;
+    m_keys[node] = popped;
+    m_popped = true;
+    return node;
+  }
+
+  double top_key() {
+    refill();
+    return m_base + m_last / m_scale;
+  }
+
+  bool empty() {
+    refill();
+    return m_size == 0;
+  }
+
+  size_t stale_pops() const { return m_stale; }
+
+ private:
+  size_t bucket(const uint64_t key) const {
+    return key == m_last ? 0 : 64 - __builtin_clzll(key ^ m_last);
+  }
+
+  // Moves the base down to a smaller key, raising the keys queued so far by
+  // the difference. Only valid while nothing has been popped.
+  void rebase(const double base) {
+    const uint64_t shift = static_cast<uint64_t>((m_base - base) * m_scale);
+    std::vector<std::pair<uint64_t, node_index_t>> entries;
+    for (auto& bucket : m_buckets) {
+      for (const auto& entry : bucket) {
+        if (entry.first == m_keys[entry.second]) {
+          entries.push_back(entry);
+        } else {
+          m_size--;
+          m_stale++;
+        }
+      }
+      bucket.clear();
+    }
+    m_base = base;
+    m_last = 0;
+    for (auto& entry : entries) {
+      entry.first += shift;
+      m_keys[entry.second] = entry.first;
+      m_buckets[bucket(entry.first)].push_back(entry);
+    }
+  }
+
+  // Ensure bucket 0 holds a live entry with the minimum key
+  void refill() {
+    auto& zero = m_buckets[0];
+    while (true) {
+      while (!zero.empty() &&
+             zero.back().first != m_keys[zero.back().second]) {
+        zero.pop_back();
+        m_size--;
+        m_stale++;
+      }
+      if (!zero.empty() || m_size == 0) {
+        return;
+      }
+      size_t i = 1;
+      while (m_buckets[i].empty()) i++;
+      uint64_t min_key = std::numeric_limits<uint64_t>::max();
+      for (const auto& entry : m_buckets[i]) {
+        if (entry.first == m_keys[entry.second] && entry.first < min_key) {
+          min_key = entry.first;
+        }
+      }
+      if (min_key == std::numeric_limits<uint64_t>::max()) {
+        m_size -= m_buckets[i].size();  // Only stale entries
+        m_stale += m_buckets[i].size();
+        m_buckets[i].clear();
+        continue;
+      }
+      m_last = min_key;
+      for (const auto& entry : m_buckets[i]) {
+        if (entry.first != m_keys[entry.second]) {
+          m_size--;
+          m_stale++;
+          continue;
+        }
+        m_buckets[bucket(entry.first)].push_back(entry);
+      }
+      m_buckets[i].clear();
+    }
+  }
+
+  static constexpr uint64_t unset = std::numeric_limits<uint64_t>::max();
+  static constexpr uint64_t popped = unset - 1;
+
+  std::vector<std::pair<uint64_t, node_index_t>> m_buckets[65];
+  std::vector<uint64_t> m_keys;  // Current quantized key of each node
+  size_t m_size = 0;             // Entries in the buckets, including stale
+  size_t m_stale = 0;
+  uint64_t m_last = 0;
+  double m_base = 0;
+  double m_scale;
+  bool m_empty_since_start = true;
+  bool m_popped = false;
+};
+
+}  // namespace Queue
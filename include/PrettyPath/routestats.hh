@@ -0,0 +1,48 @@
+#include <vector>
+#include "config.hh"
+#pragma once
+
+namespace RouteStats {
+
+struct stats_t {
+  double length = 0;                  // m
+  double ascent = 0, descent = 0;     // m
+  double ascent_length = 0;           // m walked uphill
+  double descent_length = 0;          // m walked downhill
+  double flat_length = 0;             // m walked level
+  double time = 0;                    // s, estimated walking time
+  std::vector<double> grade_lengths;  // m per bin of Config::route_stats_t
+
+  void add(const stats_t& other);
+};
+
+// Stats of a whole route, the total being the sum of the legs
+struct route_t {
+  stats_t total;
+  std::vector<stats_t> legs;
+};
+
+// Accumulates the stats of a track one point at a time, in a single pass.
+// Ascent and descent only count an elevation change once it exceeds the
+// threshold, which smooths out the noise of the elevation model; 0 counts
+// every change. Each segment's grade is binned by length and timed with
+// Tobler's hiking function.
+class Accumulator {
+ public:
+  explicit Accumulator(const Config::route_stats_t& options);
+
+  // Adds a point and the segment to it from the previous point, of the given
+  // length (m), ignored for the first point
+  void add(const double length, const double elevation);
+  // Also counts a change still within the threshold at the end of the track
+  stats_t finish();
+
+ private:
+  const Config::route_stats_t& m_options;
+  stats_t m_stats;
+  bool m_started = false;
+  double m_elevation = 0;  // Of the previous point
+  double m_reference = 0;  // Elevation the next change is measured from
+};
+
+}  // namespace RouteStats
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <vector>
+#pragma once
+
+// Static R-tree over axis aligned boxes, bulk loaded by sorting the boxes
+// along a Hilbert curve through their centres and packing consecutive runs
+// bottom up. Node k of a level covers nodes [k * fanout, (k + 1) * fanout) of
+// the level below, so the whole tree is a couple of flat arrays and a query
+// walks it with a fixed size stack and no allocation.
+template <typename T>
+class PackedRTree {
+ public:
+  struct box_t {
+    T min_x, min_y, max_x, max_y;
+
+    // Squared distance from a point to the box, 0 inside it
+    T distance_squared(const T x, const T y) const {
+      const T dx = std::max({min_x - x, T(0), x - max_x});
+      const T dy = std::max({min_y - y, T(0), y - max_y});
+      return dx * dx + dy * dy;
+    }
+    bool intersects(const box_t& other) const {
+      return min_x <= other.max_x && other.min_x <= max_x &&
+             min_y <= other.max_y && other.min_y <= max_y;
+    }
+    void expand(const box_t& other) {
+      min_x = std::min(min_x, other.min_x);
+      min_y = std::min(min_y, other.min_y);
+      max_x = std::max(max_x, other.max_x);
+      max_y = std::max(max_y, other.max_y);
+    }
+  };
+
+  static constexpr size_t fanout = 16;
+
+  // Item i of the tree is boxes[i]
+  void build(const std::vector<box_t>& boxes) {
+    const size_t n = boxes.size();
+    m_boxes.clear();
+    m_items.resize(n);
+    m_level_starts = {0};
+    if (n == 0) {
+      return;
+    }
+
+    box_t bounds = boxes[0];
+    for (const box_t& box : boxes) {
+      bounds.expand(box);
+    }
+    const double width = static_cast<double>(bounds.max_x) - bounds.min_x;
+    const double height = static_cast<double>(bounds.max_y) - bounds.min_y;
+    std::vector<uint32_t> hilbert(n);
+    for (size_t i = 0; i < n; i++) {
+      const double x = (boxes[i].min_x + boxes[i].max_x) / 2.0 - bounds.min_x;
+      const double y = (boxes[i].min_y + boxes[i].max_y) / 2.0 - bounds.min_y;
+      hilbert[i] = hilbert_index(width > 0 ? x / width * 65535 : 0,
+                                 height > 0 ? y / height * 65535 : 0);
+    }
+    std::iota(m_items.begin(), m_items.end(), 0);
+    std::sort(m_items.begin(), m_items.end(),
+              [&](const uint32_t a, const uint32_t b) {
+                return hilbert[a] < hilbert[b];
+              });
+
+    m_boxes.reserve(n + n / (fanout - 1) + 1);
+    for (const uint32_t item : m_items) {
+      m_boxes.push_back(boxes[item]);
+    }
+    size_t start = 0, end = n;
+    m_level_starts.push_back(end);
+    do {
+      for (size_t first = start; first < end; first += fanout) {
+        box_t node = m_boxes[first];
+        for (size_t i = first + 1; i < std::min(first + fanout, end); i++) {
+          node.expand(m_boxes[i]);
+        }
+        m_boxes.push_back(node);
+      }
+      start = end;
+      end = m_boxes.size();
+      m_level_starts.push_back(end);
+    } while (end - start > 1);
+  }
+
+  size_t size() const { return m_items.size(); }
+
+  // Calls visit(item) for every item whose box intersects box
+  template <typename F>
+  void query(const box_t& box, F&& visit) const {
+    if (m_items.empty() || !m_boxes.back().intersects(box)) {
+      return;
+    }
+    std::array<uint32_t, max_stack> stack;
+    size_t top = 0;
+    stack[top++] = m_boxes.size() - 1;
+    while (top > 0) {
+      const uint32_t node = stack[--top];
+      size_t first, last;
+      const size_t level = children(node, first, last);
+      for (size_t child = first; child < last; child++) {
+        if (!m_boxes[child].intersects(box)) continue;
+        if (level == 1) {
+          visit(m_items[child]);
+        } else {
+          stack[top++] = child;
+        }
+      }
+    }
+  }
+
+  // The item nearest to (x, y) by distance_squared(item), which must be at
+  // least the squared distance to the item's box, among the items accept
+  // allows. size() when there is none. Best first, so only the nodes nearer
+  // than the answer are opened.
+  template <typename D, typename A>
+  uint32_t nearest(const T x, const T y, D&& distance_squared,
+                   A&& accept) const {
+    if (m_items.empty()) {
+      return size();
+    }
+    // Queued nodes by box distance, and leaves by their item's distance
+    using entry_t = std::pair<T, uint32_t>;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>>
+        queue;
+    queue.push({m_boxes.back().distance_squared(x, y), m_boxes.size() - 1});
+    while (!queue.empty()) {
+      const uint32_t node = queue.top().second;
+      queue.pop();
+      if (node < m_level_starts[1]) {
+        return m_items[node];
+      }
+      size_t first, last;
+      const size_t level = children(node, first, last);
+      for (size_t child = first; child < last; child++) {
+        if (level > 1) {
+          queue.push({m_boxes[child].distance_squared(x, y), child});
+        } else if (accept(m_items[child])) {
+          queue.push({distance_squared(m_items[child]), child});
+        }
+      }
+    }
+    return size();
+  }
+
+ private:
+  // Each level pushes at most fanout nodes and pops one, and 2^32 items
+  // need at most 8 levels
+  static constexpr size_t max_stack = 8 * fanout;
+
+  // Level of a node above the items, and the range of its children
+  size_t children(const uint32_t node, size_t& first, size_t& last) const {
+    size_t level = 1;
+    while (node >= m_level_starts[level + 1]) level++;
+    first = m_level_starts[level - 1] + (node - m_level_starts[level]) * fanout;
+    last = std::min(first + fanout, m_level_starts[level]);
+    return level;
+  }
+
+  // Position along a Hilbert curve through a 65536 x 65536 grid
+  static uint32_t hilbert_index(uint32_t x, uint32_t y) {
+    uint32_t index = 0;
+    for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+      const uint32_t rx = (x & s) > 0;
+      const uint32_t ry = (y & s) > 0;
+      index += s * s * ((3 * rx) ^ ry);
+      if (ry == 0) {
+        if (rx == 1) {
+          x = 65535 - x;
+          y = 65535 - y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return index;
+  }
+
+  // Item boxes in Hilbert order, then the nodes of each level up to the root
+  std::vector<box_t> m_boxes;
+  std::vector<uint32_t> m_items;  // Item of each leaf box
+  // First box of each level, and one past the root
+  std::vector<size_t> m_level_starts;
+};
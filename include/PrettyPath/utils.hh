@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <new>
+#include <utility>
 #pragma once
 
 namespace utils {
@@ -15,4 +19,75 @@ inline double haversine_distance(const double lat1, const double lon1,
   const double c = 2 * atan2(sqrt(a), sqrt(1 - a));
   return R * c * 1000;  // Distance in m
 }
+
+// Equirectangular projection about the middle of a bounding box, in metres.
+// East-west distances are scaled by the cosine of the box's poleward
+// latitude, so within the box the planar distance is a lower bound on the
+// haversine distance, short of it by at most tan(lat) * (lat span in
+// radians) of the east-west component (0.7% for a 0.3 degree box at 54 N).
+// Projected coordinates are floats relative to the box centre; their
+// rounding can push a distance over haversine by about 1 mm per 30 km.
+class LocalProjection {
+ public:
+  LocalProjection() = default;
+  LocalProjection(const double min_lat, const double max_lat,
+                  const double min_lon, const double max_lon)
+      : m_lat0((min_lat + max_lat) / 2),
+        m_lon0((min_lon + max_lon) / 2),
+        m_x_scale(earth_radius * deg2rad(1) *
+                  cos(deg2rad(std::max(std::abs(min_lat),
+                                       std::abs(max_lat))))),
+        m_y_scale(earth_radius * deg2rad(1)) {}
+
+  std::pair<float, float> project(const double lat, const double lon) const {
+    return std::make_pair((lon - m_lon0) * m_x_scale,
+                          (lat - m_lat0) * m_y_scale);
+  }
+
+  double distance(const double lat1, const double lon1, const double lat2,
+                  const double lon2) const {
+    const double dx = (lon2 - lon1) * m_x_scale;
+    const double dy = (lat2 - lat1) * m_y_scale;
+    return sqrt(dx * dx + dy * dy);
+  }
+
+ private:
+  static constexpr double earth_radius = 6371000;  // m, as haversine
+
+  double m_lat0 = 0, m_lon0 = 0;
+  double m_x_scale = earth_radius * deg2rad(1);
+  double m_y_scale = earth_radius * deg2rad(1);
+};
+
+// Planar distance in m from (x, y) to each of the n projected points
+// (xs[i], ys[i]). Built for AVX2 and a portable baseline on x86-64 and picked
+// at load time; other targets (e.g. NEON on AArch64) get whatever the
+// compiler vectorizes for the baseline.
+void distances_to(const float x, const float y, const float* xs,
+                  const float* ys, const size_t n, float* distances);
+
+// Allocator for containers whose storage should start on a cache line
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(const std::size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+  void deallocate(T* p, const std::size_t) {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  bool operator==(const AlignedAllocator&) const { return true; }
+  bool operator!=(const AlignedAllocator&) const { return false; }
+};
 }  // namespace utils
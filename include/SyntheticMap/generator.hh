@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <iostream>
+#include <osmium/builder/attr.hpp>
+#include <osmium/io/pbf_output.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+#pragma once
+
+// Synthetic inputs for OSMParser: a jittered lattice of footpaths and roads
+// with OSM style tags, named water polygons and peaks written as PBF, and a
+// matching fractal terrain written as a GeoTIFF. Everything is a pure
+// function of the seed and lattice position, so nodes and ways are streamed
+// without holding the map in memory.
+namespace synthmap {
+
+struct Bounds {
+  double min_lat = 54.40;
+  double max_lat = 54.48;
+  double min_lon = -3.10;
+  double max_lon = -2.84;
+};
+
+struct Options {
+  Bounds bounds;
+  uint64_t nodes = 100000;       // Approximate number of way nodes
+  uint64_t seed = 1;
+  uint64_t tarns = 0;            // 0 scales with nodes
+  uint64_t peaks = 0;            // 0 scales with nodes
+  unsigned int shape_nodes = 3;  // Intermediate nodes per lattice segment
+  double dem_resolution = 30;    // m
+};
+
+// Uniform double in [0, 1) from a seed and three integer keys
+double hash_unit(const uint64_t seed, const uint64_t a, const uint64_t b = 0,
+                 const uint64_t c = 0);
+
+// Fractal Brownian motion terrain, in m above sea level
+class Terrain {
+ public:
+  Terrain(const Bounds& bounds, const uint64_t seed);
+
+  float elevation(const double lat, const double lon) const;
+  bool write_geotiff(const std::string& filename,
+                     const double resolution) const;
+
+  // Metres per degree, for local distances
+  double lat_to_m() const { return m_lat_to_m; }
+  double lon_to_m() const { return m_lon_to_m; }
+
+ private:
+  double noise(const double x, const double y, const uint64_t octave) const;
+
+  Bounds m_bounds;
+  uint64_t m_seed;
+  double m_lat_to_m, m_lon_to_m;
+};
+
+class NetworkWriter {
+ public:
+  NetworkWriter(const Options& options, const Terrain& terrain);
+
+  bool write_pbf(const std::string& filename);
+
+ private:
+  using location_t = std::pair<double, double>;  // (lat, lon)
+  using tags_t = std::vector<std::pair<std::string, std::string>>;
+
+  // Lattice geometry, segments run east (horizontal) or south from a junction
+  location_t junction(const uint64_t row, const uint64_t col) const;
+  location_t shape_node(const bool horizontal, const uint64_t row,
+                        const uint64_t col, const unsigned int index) const;
+  bool has_segment(const bool horizontal, const uint64_t row,
+                   const uint64_t col) const;
+  osmium::object_id_type junction_id(const uint64_t row,
+                                     const uint64_t col) const;
+  osmium::object_id_type shape_id(const bool horizontal, const uint64_t row,
+                                  const uint64_t col,
+                                  const unsigned int index) const;
+  location_t water_node(const uint64_t water, const unsigned int index) const;
+  unsigned int water_size(const uint64_t water) const;
+  tags_t way_tags(const osmium::object_id_type way_id,
+                  const double slope) const;
+
+  void write_nodes();
+  void write_ways(const bool horizontal);
+  void write_water();
+  void add_node(const osmium::object_id_type id, const location_t& location,
+                const tags_t& tags = {});
+  void add_way(const std::vector<osmium::object_id_type>& nodes,
+               const tags_t& tags);
+  void flush(const bool force = false);
+
+  Options m_options;
+  const Terrain& m_terrain;
+  uint64_t m_rows, m_cols;
+  double m_row_step, m_col_step;  // Degrees between junctions
+  osmium::object_id_type m_shape_base[2];  // First shape node id, by direction
+  osmium::object_id_type m_water_base, m_peak_base;
+  osmium::object_id_type m_next_way = 1;
+  uint64_t m_node_count = 0, m_way_count = 0;
+  osmium::io::Writer* m_writer = nullptr;
+  osmium::memory::Buffer m_buffer;
+};
+
+}  // namespace synthmap
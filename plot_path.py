@@ -3,6 +3,7 @@ from PIL import Image, ImageDraw, ImageFont
 import os
 import sys
 import fnmatch
+import json
 
 font_path = "/System/Library/Fonts/Helvetica.ttc"
 regen_markers = True
@@ -54,6 +55,19 @@ def calculate_ascent_descent(path):
     flat_length /= 1000
     return total_ascent, ascent_length, total_descent, descent_length, flat_length
 
+# Leg stats written by PrettyPath in route.json, keyed by (start, end) tarn
+def read_leg_stats(directory, route_filename='route.json'):
+    filename = os.path.join(directory, route_filename)
+    if not os.path.exists(filename):
+        return {}
+    with open(filename, 'r') as file:
+        route = json.load(file)
+    if 'stats' not in route:
+        return {}
+    names = [waypoint['name'] for waypoint in route['waypoints']]
+    return {(names[i], names[i + 1]): leg
+            for i, leg in enumerate(route['stats']['legs'])}
+
 def extract_tarn_names(filename):
     tarns = filename[:-len(".csv")]
     start_tarn, end_tarn = tarns.split("_to_")
@@ -86,6 +100,7 @@ def plot_paths(directory='data/path'):
     tarn_order = {}
     context = staticmaps.Context()
     context.set_tile_provider(staticmaps.tile_provider_OSM)
+    leg_stats = read_leg_stats(directory)
     for i, filename in enumerate(os.listdir(directory)):
         if not fnmatch.fnmatch(filename, '*.csv'):
             continue
@@ -95,7 +110,14 @@ def plot_paths(directory='data/path'):
         if len(path) < 2:
             continue
 
-        total_ascent, ascent_length, total_descent, descent_length, flat_length = calculate_ascent_descent(path)
+        stats = leg_stats.get((start_tarn, end_tarn))
+        if stats is not None:
+            total_ascent, total_descent = stats['ascent'], stats['descent']
+            ascent_length = stats['ascent_length'] / 1000
+            descent_length = stats['descent_length'] / 1000
+            flat_length = stats['flat_length'] / 1000
+        else:
+            total_ascent, ascent_length, total_descent, descent_length, flat_length = calculate_ascent_descent(path)
         print("Path from", start_tarn, "to", end_tarn)
         print(f"Total ascent: {total_ascent:.2f} m in {ascent_length:.2f} km")
         print(f"Total descent: {total_descent:.2f} m in {descent_length:.2f} km")
@@ -265,15 +265,14 @@ void osmparser::Handler::write_nodes_file() {
 
 void osmparser::Handler::write_edges_file() {
   std::cout << "Writing edges..." << std::endl;
-  m_edges_file << "id,osm_id,source_id,target_id,length,slope,difficulty,cars,"
-                  "geometry\n";
+  m_edges_file << "id,osm_id,source_id,target_id,length,slope,ascent,descent,"
+                  "difficulty,cars,geometry\n";
   m_edges_file << std::fixed << std::setprecision(6);
   for (const auto& way_pair : m_ways) {
     const osmium::object_id_type way_id = way_pair.first;
     const WayData& way_data = way_pair.second;
     osmium::object_id_type source, target = 0;
-    float length = 0, ele_gain = 0, ele_loss = 0, ascend_length = 0,
-          descend_length = 0;
+    float length = 0, ele_gain = 0, ele_loss = 0;
     std::vector<osmium::object_id_type> edge_nodes;
 
     for (auto it = way_data.nodes.begin(); it != way_data.nodes.end(); ++it) {
@@ -293,26 +292,22 @@ void osmparser::Handler::write_edges_file() {
 
         if (ele_diff > 0) {
           ele_gain += ele_diff;
-          ascend_length += distance;
         } else if (ele_diff < 0) {
           ele_loss += -ele_diff;
-          descend_length += distance;
         }
 
         if ((m_nodes.at(node.ref()).ways > 1 ||
              it == way_data.nodes.end() - 1) &&
             node.ref() != source) {
           target = node.ref();
-          // TODO how to process elevation ??
-          const double ascent_slope =
-              ascend_length > 0 ? ele_gain / ascend_length : 0;
-          const double descent_slope =
-              descend_length > 0 ? ele_loss / descend_length : 0;
+          // Ascent and descent in m from source to target, summed per
+          // segment so undulations are not lost in the net slope
           const double slope = (ele_gain - ele_loss) / length;
           const auto id = m_edge_counter++;
           m_edges_file << id << "," << way_id << "," << source << "," << target
-                       << "," << length << "," << slope << ","
-                       << way_data.difficulty << "," << way_data.cars;
+                       << "," << length << "," << slope << "," << ele_gain
+                       << "," << ele_loss << "," << way_data.difficulty << ","
+                       << way_data.cars;
           for (auto it = edge_nodes.begin(); it != edge_nodes.end(); ++it) {
             m_edges_file << "," << *it;  // Store all nodes on the edge
           }
@@ -321,8 +316,6 @@ void osmparser::Handler::write_edges_file() {
           length = 0;
           ele_gain = 0;
           ele_loss = 0;
-          ascend_length = 0;
-          descend_length = 0;
           edge_nodes.clear();
           edge_nodes.push_back(node.ref());
         }
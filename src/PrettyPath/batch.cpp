@@ -0,0 +1,261 @@
+#include "batch.hh"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <tuple>
+#include "graph.hh"
+#include "metrics.hh"
+#include "parser.hh"
+#include "pathfinder.hh"
+#include "poirouter.hh"
+#include "profile.hh"
+
+namespace Batch {
+
+namespace {
+
+struct scenario_t {
+  std::string name;
+  Config::config_t config;
+  size_t profile = 0;  // Index of its compiled profile
+};
+
+struct result_t {
+  bool found = false;
+  double length = 0;  // m
+  double ascent = 0;   // m
+  double descent = 0;  // m
+  double walk = 0;     // h, estimated walking time
+  size_t tarns = 0;    // Distinct tarns on the route
+  double time = 0;     // ms, routing without writing the outputs
+};
+
+// Scenarios that agree on everything a compiled profile depends on share
+// one, landmarks included
+using profile_key_t =
+    std::tuple<float, float, float, float, int, int, size_t>;
+
+profile_key_t profile_key(const Config::config_t& config) {
+  return std::make_tuple(config.length_weight, config.elevation_weight,
+                         config.difficulty_weight, config.cars_weight,
+                         config.max_difficulty, config.max_cars,
+                         config.search.landmarks);
+}
+
+bool read_scenarios(const nlohmann::json& base_config,
+                    const Config::config_t& base,
+                    const std::string& filename,
+                    std::vector<scenario_t>& scenarios) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Could not open scenarios file " << filename << std::endl;
+    return false;
+  }
+  nlohmann::json overlays;
+  file >> overlays;
+  if (!overlays.is_array() || overlays.empty()) {
+    std::cerr << "Scenarios file must hold an array of config overlays"
+              << std::endl;
+    return false;
+  }
+
+  std::set<std::string> names;
+  for (size_t i = 0; i < overlays.size(); i++) {
+    nlohmann::json overlay = overlays[i];
+    if (!overlay.is_object()) {
+      std::cerr << "Scenario " << i << " is not an object" << std::endl;
+      return false;
+    }
+    scenario_t scenario;
+    scenario.name = overlay.value("name", "scenario_" + std::to_string(i));
+    overlay.erase("name");
+    if (!names.insert(scenario.name).second) {
+      std::cerr << "Duplicate scenario name " << scenario.name << std::endl;
+      return false;
+    }
+
+    nlohmann::json config = base_config;
+    config.merge_patch(overlay);
+    Config::get_config(config, scenario.config);
+    if (!Config::check_config(scenario.config)) {
+      std::cerr << "Invalid scenario " << scenario.name << std::endl;
+      return false;
+    }
+    if (scenario.config.nodes_filename != base.nodes_filename ||
+        scenario.config.edges_filename != base.edges_filename) {
+      std::cerr << "Scenario " << scenario.name
+                << " changes the map files, batch mode loads the map once"
+                << std::endl;
+      return false;
+    }
+    scenarios.push_back(scenario);
+  }
+  return true;
+}
+
+result_t run_scenario(const Graph& graph, const MapData& map,
+                      const RoutingProfile& profile,
+                      const std::map<std::string, POICatalogue>& catalogues,
+                      const scenario_t& scenario) {
+  const Config::config_t& config = scenario.config;
+  result_t result;
+  const auto start = std::chrono::steady_clock::now();
+
+  std::pair<std::vector<std::pair<const POIData, size_t>>, path_t> path;
+  Pathfinder::isochrone_t isochrone;
+  if (config.use_ordered_tarns) {
+    auto tarns = Parser::read_ordered_poi_data(config.tarns_filename);
+    path = TarnRouter::find_shortest_path_between_ordered_tarns(
+        graph, profile, tarns, config.start_location, config.search);
+  } else {
+    auto tarns = TarnRouter::select_tarns(
+        catalogues.at(config.tarns_filename), config);
+    path = TarnRouter::find_shortest_path_between_tarns(
+        graph, profile, tarns, config.min_path_length, config.max_path_length,
+        config.start_location, config.seed, config.search, nullptr,
+        &isochrone);
+  }
+  result.time = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  const std::string output_dir = config.output_dir + scenario.name + "/";
+  if (isochrone.source && !config.isochrone_filename.empty()) {
+    std::filesystem::create_directories(output_dir);
+    Parser::write_isochrone(graph, isochrone,
+                            output_dir + config.isochrone_filename);
+  }
+  if (path.first.empty()) {
+    return result;
+  }
+
+  result.found = true;
+  result.length = TarnRouter::get_route_length(graph, path);
+  std::set<std::string> tarns;
+  for (const auto& poi : path.first) {
+    if (poi.first.name != "Start") tarns.insert(poi.first.name);
+  }
+  result.tarns = tarns.size();
+
+  const auto stats = Parser::write_paths(
+      map, graph, path, output_dir, config.gpx_filename,
+      config.route_filename, config.route_output);
+  result.ascent = stats.total.ascent;
+  result.descent = stats.total.descent;
+  result.walk = stats.total.time / 3600;
+  return result;
+}
+
+void write_summary(const std::vector<scenario_t>& scenarios,
+                   const std::vector<result_t>& results,
+                   const std::string& filename) {
+  std::string csv =
+      "name,found,length,ascent,descent,walk_h,tarns,time_ms\n";
+  printf("\n%-24s %5s %10s %8s %9s %6s %5s %10s\n", "Scenario", "Found",
+         "Length m", "Ascent m", "Descent m", "Walk h", "Tarns", "Time ms");
+  for (size_t i = 0; i < scenarios.size(); i++) {
+    const result_t& result = results[i];
+    printf("%-24s %5s %10.0f %8.0f %9.0f %6.1f %5zu %10.1f\n",
+           scenarios[i].name.c_str(), result.found ? "yes" : "no",
+           result.length, result.ascent, result.descent, result.walk,
+           result.tarns, result.time);
+    csv += scenarios[i].name + "," + (result.found ? "1" : "0") + "," +
+           std::to_string(result.length) + "," +
+           std::to_string(result.ascent) + "," +
+           std::to_string(result.descent) + "," +
+           std::to_string(result.walk) + "," + std::to_string(result.tarns) +
+           "," + std::to_string(result.time) + "\n";
+  }
+  if (Parser::write_file(filename, csv)) {
+    std::cout << "Wrote summary to " << filename << std::endl;
+  }
+}
+
+}  // namespace
+
+bool run_scenarios(const nlohmann::json& base_config,
+                   const std::string& scenarios_filename,
+                   const size_t threads) {
+  Config::config_t base;
+  Config::get_config(base_config, base);
+  std::vector<scenario_t> scenarios;
+  if (!read_scenarios(base_config, base, scenarios_filename, scenarios)) {
+    return false;
+  }
+
+  const auto load_start = std::chrono::steady_clock::now();
+  Parser parser(base.nodes_filename, base.edges_filename);
+  Graph graph;
+  MapData map = parser.read_map_data(graph);
+  Metrics::add_time(Metrics::Phase::Load,
+                    std::chrono::steady_clock::now() - load_start);
+
+  std::vector<std::unique_ptr<RoutingProfile>> profiles;
+  std::map<profile_key_t, size_t> profile_index;
+  for (scenario_t& scenario : scenarios) {
+    const auto inserted =
+        profile_index.emplace(profile_key(scenario.config), profiles.size());
+    if (inserted.second) {
+      profiles.push_back(
+          std::make_unique<RoutingProfile>(graph, scenario.config));
+      profiles.back()->build_landmarks(graph,
+                                       scenario.config.search.landmarks);
+    }
+    scenario.profile = inserted.first->second;
+  }
+  // Scenarios only differ in how they query the tarns, so each tarn file is
+  // read and indexed once
+  std::map<std::string, POICatalogue> catalogues;
+  for (const scenario_t& scenario : scenarios) {
+    const std::string& filename = scenario.config.tarns_filename;
+    if (scenario.config.use_ordered_tarns || catalogues.count(filename) > 0) {
+      continue;
+    }
+    POICatalogue& catalogue = catalogues[filename];
+    Parser::read_poi_catalogue(filename, POIKind::Tarn, catalogue);
+    catalogue.build();
+  }
+  const auto run_start = std::chrono::steady_clock::now();
+  std::cout << "Loaded the map, " << catalogues.size()
+            << " tarn catalogues and compiled " << profiles.size()
+            << " profiles for " << scenarios.size() << " scenarios in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   run_start - load_start)
+                   .count()
+            << " ms" << std::endl;
+
+  // Workers take the next scenario until none are left
+  size_t num_threads = threads != 0 ? threads
+                                    : std::thread::hardware_concurrency();
+  num_threads = std::max<size_t>(1, std::min(num_threads, scenarios.size()));
+  std::vector<result_t> results(scenarios.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < num_threads; t++) {
+    workers.emplace_back([&]() {
+      for (size_t i = next++; i < scenarios.size(); i = next++) {
+        results[i] = run_scenario(graph, map, *profiles[scenarios[i].profile],
+                                  catalogues, scenarios[i]);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  std::cout << "Ran " << scenarios.size() << " scenarios on " << num_threads
+            << " threads in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - run_start)
+                   .count()
+            << " ms" << std::endl;
+
+  std::filesystem::create_directories(base.output_dir);
+  write_summary(scenarios, results, base.output_dir + "batch_summary.csv");
+  parser.clean_map_data(map);
+  return true;
+}
+
+}  // namespace Batch
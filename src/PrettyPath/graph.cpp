@@ -1,46 +1,114 @@
 #include "graph.hh"
+#include <numeric>
 
-void Graph::add_edge(const Node* node1, const Node* node2, const double length,
-                     const double slope, const int cars, const long osm_id,
-                     const std::vector<node_id_t> edge_nodes) {
-  const Edge edge(length, slope, cars, osm_id, edge_nodes);
-  if (m_graph.find(node1) == m_graph.end()) {
-    m_graph[node1] = std::vector<std::pair<const Node*, const Edge>>();
+void Graph::add_edge(const Node node1, const Node node2, const double length,
+                     const float ascent, const float descent, const int cars,
+                     const int difficulty, const long osm_id,
+                     const std::vector<node_index_t>& geometry) {
+  const edge_index_t edge = m_edges.size();
+  const node_index_t index1 = add_node(node1);
+  const node_index_t index2 = add_node(node2);
+  m_edges.push_back(Edge(index1, index2, length, ascent, descent, cars,
+                         difficulty, osm_id, m_geometry.add(geometry)));
+  m_graph[index1].push_back(std::make_pair(index2, edge));
+  m_graph[index2].push_back(std::make_pair(index1, edge));
+}
+
+void NodeStore::sort_by_id() {
+  if (std::is_sorted(m_ids.begin(), m_ids.end())) {
+    return;  // OSM extracts are usually sorted already
   }
-  if (m_graph.find(node2) == m_graph.end()) {
-    m_graph[node2] = std::vector<std::pair<const Node*, const Edge>>();
+  std::vector<node_index_t> order(m_ids.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const node_index_t a, const node_index_t b) {
+                     return m_ids[a] < m_ids[b];
+                   });
+  auto permute = [&](auto& column) {
+    std::remove_reference_t<decltype(column)> sorted(column.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      sorted[i] = column[order[i]];
+    }
+    column.swap(sorted);
+  };
+  permute(m_ids);
+  permute(m_latitudes);
+  permute(m_longitudes);
+  permute(m_elevations);
+}
+
+// Copy the node into the graph's store unless it is already there
+node_index_t Graph::add_node(const Node node) {
+  const auto it = m_node_index.find(node.get_id());
+  if (it != m_node_index.end()) {
+    return it->second;
   }
-  m_graph[node1].push_back(std::make_pair(node2, edge));
-  m_graph[node2].push_back(std::make_pair(node1, edge));
+  const node_index_t index = m_nodes.add(*node.get_store(), node.get_index());
+  m_node_index[node.get_id()] = index;
+  m_graph.emplace_back();
+  const auto location = get_node(index).get_location();
+  const auto point = m_projection.project(location.first, location.second);
+  m_x.push_back(point.first);
+  m_y.push_back(point.second);
+  return index;
 }
 
-std::vector<const Node*> Graph::get_nodes() const {
-  std::vector<const Node*> nodes;
-  for (const auto& pair : m_graph) {
-    nodes.push_back(pair.first);
+void Graph::set_projection(const utils::LocalProjection& projection) {
+  m_projection = projection;
+  for (node_index_t index = 0; index < m_nodes.size(); index++) {
+    const auto location = get_node(index).get_location();
+    const auto point = m_projection.project(location.first, location.second);
+    m_x[index] = point.first;
+    m_y[index] = point.second;
   }
-  return nodes;
 }
 
-void Graph::apply_to_nodes(std::function<void(const Node*)> func) const {
-  for (const auto& pair : m_graph) {
-    func(pair.first);
+std::vector<float> Graph::distances_from(const double latitude,
+                                         const double longitude) const {
+  const auto point = m_projection.project(latitude, longitude);
+  std::vector<float> distances(m_nodes.size());
+  utils::distances_to(point.first, point.second, m_x.data(), m_y.data(),
+                      m_nodes.size(), distances.data());
+  return distances;
+}
+
+std::vector<Node> Graph::get_nodes() const {
+  std::vector<Node> nodes;
+  nodes.reserve(m_nodes.size());
+  for (node_index_t index = 0; index < m_nodes.size(); index++) {
+    nodes.push_back(get_node(index));
   }
+  return nodes;
 }
 
-std::vector<std::pair<const Node*, const Edge>> Graph::get_neighbours(
-    const Node* node) const {
-  return m_graph.at(node);
+void Graph::apply_to_nodes(std::function<void(const Node)> func) const {
+  for (node_index_t index = 0; index < m_nodes.size(); index++) {
+    func(get_node(index));
+  }
 }
 
-std::pair<const Node*, double> Graph::find_closest_node(
-    const double latitude, const double longitude) const {
-  const Node* closest_node = nullptr;
+std::pair<Node, double> Graph::find_closest_node(const double latitude,
+                                                 const double longitude) const {
+  Node closest_node;
   double min_distance = std::numeric_limits<double>::max();
+  const std::vector<float> distances = distances_from(latitude, longitude);
+  if (distances.empty()) {
+    return std::make_pair(closest_node, min_distance);
+  }
 
-  for (auto& pair : m_graph) {
-    const Node* node = pair.first;
-    const double distance = node->distance_to(latitude, longitude);
+  // Projected distances are lower bounds, so only nodes projected within the
+  // haversine distance of the projected closest node can be closer
+  const size_t projected_closest =
+      std::min_element(distances.begin(), distances.end()) - distances.begin();
+  closest_node = get_node(projected_closest);
+  min_distance = closest_node.distance_to(latitude, longitude);
+  const double bound = min_distance;
+  for (node_index_t index = 0; index < m_nodes.size(); index++) {
+    if (distances[index] > bound) {
+      continue;
+    }
+    const Node node = get_node(index);
+    const double distance = node.distance_to(latitude, longitude);
     if (distance < min_distance) {
       min_distance = distance;
       closest_node = node;
@@ -50,18 +118,99 @@ std::pair<const Node*, double> Graph::find_closest_node(
   return std::make_pair(closest_node, min_distance);
 }
 
+void Graph::build_segment_index(const NodeStore& geometry_nodes) {
+  m_segments.clear();
+  m_projected_lengths.assign(m_edges.size(), 0);
+  std::vector<std::pair<float, float>> points;
+  for (edge_index_t edge = 0; edge < m_edges.size(); edge++) {
+    points.clear();
+    for (const node_index_t node : get_geometry(edge)) {
+      points.push_back(m_projection.project(geometry_nodes.latitude(node),
+                                            geometry_nodes.longitude(node)));
+    }
+    // Edges without geometry run straight between their ends
+    if (points.size() < 2) {
+      const node_index_t source = m_edges[edge].get_source();
+      const node_index_t target = m_edges[edge].get_target();
+      points = {{m_x[source], m_y[source]}, {m_x[target], m_y[target]}};
+    }
+    float offset = 0;
+    for (size_t i = 1; i < points.size(); i++) {
+      const segment_t segment = {points[i - 1].first, points[i - 1].second,
+                                 points[i].first,     points[i].second,
+                                 edge,                offset};
+      m_segments.push_back(segment);
+      offset += std::hypot(segment.x2 - segment.x1, segment.y2 - segment.y1);
+    }
+    m_projected_lengths[edge] = offset;
+  }
+
+  std::vector<PackedRTree<float>::box_t> boxes;
+  boxes.reserve(m_segments.size());
+  for (const segment_t& segment : m_segments) {
+    boxes.push_back({std::min(segment.x1, segment.x2),
+                     std::min(segment.y1, segment.y2),
+                     std::max(segment.x1, segment.x2),
+                     std::max(segment.y1, segment.y2)});
+  }
+  m_segment_tree.build(boxes);
+}
+
+snap_t Graph::snap(
+    const double latitude, const double longitude,
+    const std::function<bool(const edge_index_t)>& accept) const {
+  const auto point = m_projection.project(latitude, longitude);
+  const float x = point.first, y = point.second;
+
+  // Squared distance to the nearest point of a segment, t of the way along
+  auto closest = [&](const segment_t& segment, float& t) {
+    const float dx = segment.x2 - segment.x1, dy = segment.y2 - segment.y1;
+    const float length_squared = dx * dx + dy * dy;
+    t = length_squared > 0 ? ((x - segment.x1) * dx + (y - segment.y1) * dy) /
+                                 length_squared
+                           : 0;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    const float px = segment.x1 + t * dx - x, py = segment.y1 + t * dy - y;
+    return px * px + py * py;
+  };
+
+  snap_t snap;
+  const uint32_t nearest = m_segment_tree.nearest(
+      x, y,
+      [&](const uint32_t i) {
+        float t;
+        return closest(m_segments[i], t);
+      },
+      [&](const uint32_t i) { return accept(m_segments[i].edge); });
+  if (nearest == m_segments.size()) {
+    return snap;
+  }
+
+  const segment_t& segment = m_segments[nearest];
+  float t;
+  snap.distance = std::sqrt(closest(segment, t));
+  snap.edge = segment.edge;
+  snap.x = segment.x1 + t * (segment.x2 - segment.x1);
+  snap.y = segment.y1 + t * (segment.y2 - segment.y1);
+  const float length = m_projected_lengths[segment.edge];
+  const float along =
+      segment.offset +
+      t * std::hypot(segment.x2 - segment.x1, segment.y2 - segment.y1);
+  snap.fraction = length > 0 ? std::min(along / length, 1.0f) : 0;
+  return snap;
+}
+
 void Graph::print_graph_info() const {
   size_t num_nodes = m_graph.size();
   size_t num_edges = 0;
   std::map<node_id_t, node_id_t> num_edges_per_node;
-  for (const auto& pair : m_graph) {
-    num_edges += pair.second.size();
-    const Node* node = pair.first;
-    if (num_edges_per_node.find(pair.second.size()) ==
+  for (const auto& neighbours : m_graph) {
+    num_edges += neighbours.size();
+    if (num_edges_per_node.find(neighbours.size()) ==
         num_edges_per_node.end()) {
-      num_edges_per_node[pair.second.size()] = 0;
+      num_edges_per_node[neighbours.size()] = 0;
     }
-    num_edges_per_node[pair.second.size()] += 1;
+    num_edges_per_node[neighbours.size()] += 1;
   }
   std::cout << "Graph info: " << num_nodes << " nodes, " << num_edges
             << " edges" << std::endl;
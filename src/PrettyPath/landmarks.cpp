@@ -0,0 +1,108 @@
+#include <chrono>
+#include <future>
+#include "pathfinder.hh"
+#include "profile.hh"
+
+void Landmarks::build(const Graph& graph, const RoutingProfile& profile,
+                      const size_t count) {
+  m_landmarks.clear();
+  m_distances.clear();
+  if (count == 0 || graph.num_nodes() == 0) {
+    return;
+  }
+
+  const auto start_time = std::chrono::steady_clock::now();
+  const std::vector<node_index_t> landmarks =
+      select_landmarks(graph, profile, count);
+
+  // A forward and a reverse Dijkstra per landmark, run in parallel
+  std::vector<std::future<std::vector<double>>> futures;
+  for (const node_index_t landmark : landmarks) {
+    for (const bool reverse : {false, true}) {
+      futures.push_back(std::async(std::launch::async, Pathfinder::dijkstra,
+                                   std::cref(graph), std::cref(profile),
+                                   graph.get_node(landmark),
+                                   std::numeric_limits<double>::max(),
+                                   reverse));
+    }
+  }
+
+  const size_t num_nodes = graph.num_nodes();
+  const size_t columns = futures.size();
+  m_distances.assign(num_nodes * columns, unreachable);
+  for (size_t column = 0; column < columns; column++) {
+    const std::vector<double> distances = futures[column].get();
+    for (size_t node = 0; node < num_nodes; node++) {
+      if (distances[node] != std::numeric_limits<double>::max()) {
+        m_distances[node * columns + column] = distances[node];
+      }
+    }
+  }
+  m_landmarks = landmarks;
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  std::cout << "Built " << landmarks.size() << " landmarks in "
+            << elapsed.count() << " ms ("
+            << m_distances.size() * sizeof(float) / 1024 << " KiB)"
+            << std::endl;
+}
+
+// Farthest point selection within the largest connected component: each new
+// landmark is the node furthest (straight line) from all landmarks so far
+std::vector<node_index_t> Landmarks::select_landmarks(
+    const Graph& graph, const RoutingProfile& profile,
+    const size_t count) const {
+  std::vector<node_index_t> component;
+  component.reserve(profile.main_component_size());
+  for (node_index_t node = 0; node < graph.num_nodes(); node++) {
+    if (profile.component(node) == profile.main_component()) {
+      component.push_back(node);
+    }
+  }
+  std::vector<double> min_distance(component.size(),
+                                   std::numeric_limits<double>::max());
+  std::vector<node_index_t> landmarks;
+
+  auto update_min_distance = [&](const Node from) {
+    const auto location = from.get_location();
+    const std::vector<float> distances =
+        graph.distances_from(location.first, location.second);
+    for (size_t i = 0; i < component.size(); i++) {
+      const double distance = distances[component[i]];
+      if (distance < min_distance[i]) min_distance[i] = distance;
+    }
+  };
+
+  // Seed from an arbitrary node so the first landmark lies on the periphery
+  update_min_distance(graph.get_node(component.front()));
+  while (landmarks.size() < count && landmarks.size() < component.size()) {
+    const size_t farthest =
+        std::max_element(min_distance.begin(), min_distance.end()) -
+        min_distance.begin();
+    landmarks.push_back(component[farthest]);
+    update_min_distance(graph.get_node(component[farthest]));
+  }
+
+  return landmarks;
+}
+
+std::vector<float> Landmarks::virtual_row(const node_index_t* nodes,
+                                          const double* costs_to,
+                                          const double* costs_from,
+                                          const size_t count) const {
+  std::vector<float> row(2 * m_landmarks.size(), unreachable);
+  for (size_t i = 0; i < count; i++) {
+    const float* node_row = this->row(nodes[i]);
+    for (size_t j = 0; j < row.size(); j += 2) {
+      // From the landmark through the node, and through the node to it
+      if (node_row[j] != unreachable) {
+        row[j] = std::min<float>(row[j], node_row[j] + costs_from[i]);
+      }
+      if (node_row[j + 1] != unreachable) {
+        row[j + 1] = std::min<float>(row[j + 1], costs_to[i] + node_row[j + 1]);
+      }
+    }
+  }
+  return row;
+}
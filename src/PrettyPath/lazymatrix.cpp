@@ -0,0 +1,90 @@
+#include "lazymatrix.hh"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <limits>
+#include "metrics.hh"
+#include "pathfinder.hh"
+
+LazyMatrix::LazyMatrix(const Graph& graph, const RoutingProfile& profile,
+                       const std::vector<POIData>& tarns,
+                       const Config::search_t& search)
+    : m_graph(&graph),
+      m_profile(&profile),
+      m_tarns(&tarns),
+      m_search(search),
+      m_n(tarns.size()),
+      m_lengths(m_n * m_n, 0),
+      m_known(m_n * m_n, false),
+      m_paths(m_n) {
+  // No path is shorter than the straight line between its ends
+  for (size_t i = 0; i < m_n; i++) {
+    m_known[i * m_n + i] = true;
+    for (size_t j = i + 1; j < m_n; j++) {
+      const snap_t& from = tarns[i].snap;
+      const snap_t& to = tarns[j].snap;
+      const double bound = std::hypot(from.x - to.x, from.y - to.y);
+      m_lengths[i * m_n + j] = m_lengths[j * m_n + i] = bound;
+    }
+  }
+  m_straight = m_lengths;
+}
+
+LazyMatrix::LazyMatrix(const std::vector<double>& dist, const size_t n)
+    : m_n(n), m_lengths(dist), m_straight(dist), m_known(n * n, true) {}
+
+double LazyMatrix::get(const int i, const int j) {
+  if (!known(i, j)) {
+    m_searches++;
+    const auto result = search(i, j);
+    set(i, j, result.first, result.second);
+  }
+  return m_lengths[i * m_n + j];
+}
+
+void LazyMatrix::prefetch(const std::vector<std::pair<int, int>>& pairs) {
+  std::vector<std::pair<int, int>> missing;
+  for (const auto& pair : pairs) {
+    if (!known(pair.first, pair.second)) {
+      missing.push_back(pair);
+    }
+  }
+  std::sort(missing.begin(), missing.end());
+  missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+  m_searches += missing.size();
+  std::vector<std::future<std::pair<double, path_t>>> futures;
+  for (const auto& pair : missing) {
+    futures.push_back(std::async(std::launch::async, &LazyMatrix::search,
+                                 this, pair.first, pair.second));
+  }
+  for (size_t k = 0; k < missing.size(); k++) {
+    const auto result = futures[k].get();
+    set(missing[k].first, missing[k].second, result.first, result.second);
+  }
+}
+
+void LazyMatrix::set(const int i, const int j, const double length,
+                     const path_t& path) {
+  m_lengths[i * m_n + j] = length;
+  m_known[i * m_n + j] = true;
+  m_paths.add(*m_graph, i, j, path);
+}
+
+std::pair<double, path_t> LazyMatrix::search(const int i, const int j) const {
+  Metrics::ScopedTimer timer(Metrics::Phase::Matrix);
+  const POIData& from = (*m_tarns)[i];
+  const POIData& to = (*m_tarns)[j];
+  const auto path =
+      Pathfinder::find_path(*m_graph, *m_profile, from.snap, to.snap, m_search);
+  double length = 0;
+  if (path.found) {
+    length = Pathfinder::get_path_length(*m_graph, path, from.snap, to.snap);
+  }
+  if (length == 0) {
+    std::cerr << "Error: No path found between tarns: " << from.name << ":"
+              << i << " and " << to.name << ":" << j << std::endl;
+    length = std::numeric_limits<double>::max();
+  }
+  return std::make_pair(length, path.path);
+}
@@ -1,21 +1,44 @@
 #include <getopt.h>
+#include <filesystem>
+#include "batch.hh"
 #include "config.hh"
 #include "graph.hh"
+#include "matrixcache.hh"
+#include "metrics.hh"
 #include "parser.hh"
 #include "pathfinder.hh"
 #include "poirouter.hh"
+#include "profile.hh"
 
-void handle_option(int argc, char** argv, std::string& config_filename) {
+void handle_option(int argc, char** argv, std::string& config_filename,
+                   std::string& metrics_filename, std::string& batch_filename,
+                   size_t& threads) {
+  const option long_options[] = {{"config", required_argument, nullptr, 'c'},
+                                 {"metrics", required_argument, nullptr, 'm'},
+                                 {"batch", required_argument, nullptr, 'b'},
+                                 {"threads", required_argument, nullptr, 'j'},
+                                 {nullptr, 0, nullptr, 0}};
   int opt;
-  char config_filename_c[50];
-  while ((opt = getopt(argc, argv, "s:g:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "c:m:b:j:", long_options, nullptr)) !=
+         -1) {
     switch (opt) {
       case 'c':
-        sscanf(optarg, "%s", config_filename_c);
-        config_filename = std::string(config_filename_c);
+        config_filename = optarg;
+        break;
+      case 'm':
+        metrics_filename = optarg;
+        break;
+      case 'b':
+        batch_filename = optarg;
+        break;
+      case 'j':
+        threads = std::stoul(optarg);
         break;
       default:
-        std::cerr << "Usage: " << argv[0] << " -c <config_file>" << std::endl;
+        std::cerr << "Usage: " << argv[0]
+                  << " [-c|--config <config_file>] [-m|--metrics <out.json>]"
+                  << " [-b|--batch <scenarios.json>] [-j|--threads <n>]"
+                  << std::endl;
         exit(1);
     }
   }
@@ -25,25 +48,40 @@ Config::config_t Config::c;
 
 int main(int argc, char** argv) {
   std::string config_filename = "config.json";
-  handle_option(argc, argv, config_filename);
+  std::string metrics_filename;  // Empty when metrics are not requested
+  std::string batch_filename;    // Empty for a single run
+  size_t threads = 0;
+  handle_option(argc, argv, config_filename, metrics_filename, batch_filename,
+                threads);
 
   Config::get_config(config_filename);
   Config::check_config();
   Config::print_config();
 
+  if (!batch_filename.empty()) {
+    const bool ok = Batch::run_scenarios(
+        Config::read_config_file(config_filename), batch_filename, threads);
+    if (!metrics_filename.empty() && Metrics::write_json(metrics_filename)) {
+      std::cout << "Wrote metrics to " << metrics_filename << std::endl;
+    }
+    return ok ? 0 : 1;
+  }
+
   Parser parser(Config::c.nodes_filename, Config::c.edges_filename);
   Graph graph;
+  const auto load_start = std::chrono::steady_clock::now();
   MapData map = parser.read_map_data(graph);
-  std::pair<std::vector<std::pair<const POIData, size_t>>,
-            std::vector<const Node*>>
-      path;
+  RoutingProfile profile(graph, Config::c);
+  profile.build_landmarks(graph, Config::c.search.landmarks);
+  Metrics::add_time(Metrics::Phase::Load,
+                    std::chrono::steady_clock::now() - load_start);
+  std::pair<std::vector<std::pair<const POIData, size_t>>, path_t> path;
   if (!Config::c.use_ordered_tarns) {
-    auto tarns = parser.read_poi_data(Config::c.tarns_filename);
-    auto filtered_tarns = TarnRouter::filter_tarns(
-        tarns, Config::c.min_tarn_elevation, Config::c.max_tarn_elevation,
-        Config::c.min_tarn_area, Config::c.max_tarn_area,
-        Config::c.min_latitude, Config::c.max_latitude, Config::c.min_longitude,
-        Config::c.max_longitude, Config::c.tarn_blacklist);
+    POICatalogue catalogue;
+    parser.read_poi_catalogue(Config::c.tarns_filename, POIKind::Tarn,
+                              catalogue);
+    catalogue.build();
+    auto filtered_tarns = TarnRouter::select_tarns(catalogue);
     std::cout << "Filtered tarns:" << std::endl;
     for (auto tarn : filtered_tarns) {
       std::cout << "\"" << tarn.name << "\""
@@ -52,13 +90,37 @@ int main(int argc, char** argv) {
                 << " m^2" << std::endl;
     }
     std::cout << std::endl;
+    // Kept in the output directory so the next run only searches the pairs
+    // of tarns that changed
+    MatrixCache cache(graph, profile, Config::c.search);
+    const std::string cache_filename =
+        Config::c.output_dir + Config::c.matrix_cache_filename;
+    if (!Config::c.matrix_cache_filename.empty() &&
+        cache.load(cache_filename)) {
+      std::cout << "Loaded " << cache.size() << " tarn pairs from "
+                << cache_filename << std::endl;
+    }
+    Pathfinder::isochrone_t isochrone;
     path = TarnRouter::find_shortest_path_between_tarns(
-        graph, filtered_tarns, Config::c.min_path_length,
-        Config::c.max_path_length, Config::c.start_location);
+        graph, profile, filtered_tarns, Config::c.min_path_length,
+        Config::c.max_path_length, Config::c.start_location, Config::c.seed,
+        Config::c.search,
+        Config::c.matrix_cache_filename.empty() ? nullptr : &cache,
+        &isochrone);
+    if (!Config::c.matrix_cache_filename.empty()) {
+      std::filesystem::create_directories(Config::c.output_dir);
+      cache.save(cache_filename);
+    }
+    if (isochrone.source && !Config::c.isochrone_filename.empty()) {
+      std::filesystem::create_directories(Config::c.output_dir);
+      parser.write_isochrone(graph, isochrone,
+                             Config::c.output_dir +
+                                 Config::c.isochrone_filename);
+    }
   } else {
     auto tarns = parser.read_ordered_poi_data(Config::c.tarns_filename);
     path = TarnRouter::find_shortest_path_between_ordered_tarns(
-        graph, tarns, Config::c.start_location);
+        graph, profile, tarns, Config::c.start_location);
   }
 
   auto tarn_path = path.first;
@@ -66,15 +128,24 @@ int main(int argc, char** argv) {
     std::cout << "No path found" << std::endl;
   } else {
     std::cout << "Total path length: "
-              << Pathfinder::get_path_length(path.second) << " m" << std::endl;
+              << TarnRouter::get_route_length(graph, path) << " m"
+              << std::endl;
     std::cout << "Tarn order:" << std::endl;
     for (auto pair : tarn_path) {
       auto tarn = pair.first;
       std::cout << tarn.name << " at (" << tarn.latitude << ", "
                 << tarn.longitude << ")" << std::endl;
     }
-    parser.write_paths(map, graph, path, Config::c.output_dir,
-                       Config::c.gpx_filename);
+    const auto stats = parser.write_paths(
+        map, graph, path, Config::c.output_dir, Config::c.gpx_filename,
+        Config::c.route_filename, Config::c.route_output);
+    std::cout << "Total ascent: " << stats.total.ascent << " m, descent: "
+              << stats.total.descent << " m, walking time: about "
+              << stats.total.time / 3600 << " h" << std::endl;
   }
   parser.clean_map_data(map);
+
+  if (!metrics_filename.empty() && Metrics::write_json(metrics_filename)) {
+    std::cout << "Wrote metrics to " << metrics_filename << std::endl;
+  }
 }
\ No newline at end of file
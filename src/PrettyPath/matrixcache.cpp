@@ -0,0 +1,195 @@
+#include "matrixcache.hh"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace {
+
+// Bumped when the way entries are computed changes, e.g. tarns joining the
+// graph at their nearest edge rather than their nearest node, or each
+// direction of a pair being searched on its own
+const uint32_t format_version = 3;
+
+// FNV-1a over the bytes of each value
+class Fingerprint {
+ public:
+  template <typename T>
+  void add(const T value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (const unsigned char byte : bytes) {
+      m_hash = (m_hash ^ byte) * 1099511628211ull;
+    }
+  }
+  uint64_t get() const { return m_hash; }
+
+ private:
+  uint64_t m_hash = 14695981039346656037ull;
+};
+
+}  // namespace
+
+MatrixCache::MatrixCache(const Graph& graph, const RoutingProfile& profile,
+                         const Config::search_t& search)
+    : m_graph(graph) {
+  // The compiled costs cover the edges and every weight and constraint
+  Fingerprint fingerprint;
+  fingerprint.add(format_version);
+  fingerprint.add(graph.num_nodes());
+  fingerprint.add(graph.num_edges());
+  for (edge_index_t i = 0; i < graph.num_edges(); i++) {
+    const Edge& edge = graph.get_edge(i);
+    fingerprint.add(edge.get_source());
+    fingerprint.add(edge.get_target());
+    fingerprint.add(static_cast<float>(profile.cost(i, edge.get_source())));
+    fingerprint.add(static_cast<float>(profile.cost(i, edge.get_target())));
+  }
+  fingerprint.add(search.landmarks);
+  fingerprint.add(search.mode);
+  fingerprint.add(search.queue);
+  fingerprint.add(search.epsilon);
+  m_fingerprint = fingerprint.get();
+}
+
+std::string MatrixCache::key(const POIData& tarn) {
+  std::ostringstream key;
+  key << tarn.name << "@" << std::fixed << std::setprecision(6)
+      << tarn.latitude << "," << tarn.longitude;
+  return key.str();
+}
+
+bool MatrixCache::find(const POIData& from, const POIData& to,
+                       double& distance, path_t& path) const {
+  const auto it = m_entries.find(std::make_pair(key(from), key(to)));
+  if (it == m_entries.end()) {
+    return false;
+  }
+  distance = it->second.distance;
+  path = it->second.path;
+  return true;
+}
+
+void MatrixCache::insert(const POIData& from, const POIData& to,
+                         const double distance, const path_t& path) {
+  m_entries[std::make_pair(key(from), key(to))] = {distance, path};
+}
+
+void MatrixCache::retain(const std::vector<POIData>& tarns) {
+  std::set<std::string> keys;
+  for (const POIData& tarn : tarns) {
+    keys.insert(key(tarn));
+  }
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (keys.count(it->first.first) == 0 || keys.count(it->first.second) == 0)
+      it = m_entries.erase(it);
+    else
+      ++it;
+  }
+}
+
+bool MatrixCache::load(const std::string& filename) {
+  m_entries.clear();
+  m_tour.clear();
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+  if (json.is_discarded()) {
+    std::cerr << "Error: Could not parse matrix cache " << filename
+              << std::endl;
+    return false;
+  }
+  if (!json.is_object() || !json.contains("fingerprint") ||
+      !json["fingerprint"].is_number_unsigned() ||
+      json["fingerprint"].get<uint64_t>() != m_fingerprint) {
+    std::cout << "Matrix cache " << filename
+              << " is for another map or profile, ignoring it" << std::endl;
+    return false;
+  }
+
+  // A matching fingerprint with entries that do not fit the graph is as
+  // stale as a different one
+  const auto stale = [&]() {
+    std::cout << "Matrix cache " << filename
+              << " does not match the map, ignoring it" << std::endl;
+    m_entries.clear();
+    m_tour.clear();
+    return false;
+  };
+  if (!json.contains("pairs") || !json["pairs"].is_array() ||
+      !json.contains("tour") || !json["tour"].is_array()) {
+    return stale();
+  }
+
+  // Paths are stored as their first node and the edges taken from it
+  for (const auto& pair : json["pairs"]) {
+    if (!pair.is_object() || !pair.contains("from") ||
+        !pair["from"].is_string() || !pair.contains("to") ||
+        !pair["to"].is_string() || !pair.contains("distance") ||
+        !pair["distance"].is_number() || !pair.contains("start") ||
+        !pair["start"].is_number_unsigned() || !pair.contains("edges") ||
+        !pair["edges"].is_array()) {
+      return stale();
+    }
+    if (pair["start"].get<uint64_t>() >= m_graph.num_nodes()) {
+      return stale();
+    }
+    node_index_t node = pair["start"];
+    path_t path;
+    for (const auto& index : pair["edges"]) {
+      if (!index.is_number_unsigned() ||
+          index.get<uint64_t>() >= m_graph.num_edges()) {
+        return stale();
+      }
+      const Edge& edge = m_graph.get_edge(index);
+      if (edge.get_source() != node && edge.get_target() != node) {
+        return stale();
+      }
+      const node_index_t next = edge.get_source() == node ? edge.get_target()
+                                                          : edge.get_source();
+      path.push_back({index, node, next});
+      node = next;
+    }
+    m_entries[std::make_pair(pair["from"], pair["to"])] = {pair["distance"],
+                                                           path};
+  }
+  for (const auto& key : json["tour"]) {
+    if (!key.is_string()) {
+      return stale();
+    }
+    m_tour.push_back(key);
+  }
+  return true;
+}
+
+bool MatrixCache::save(const std::string& filename) const {
+  nlohmann::json json;
+  json["fingerprint"] = m_fingerprint;
+  json["tour"] = m_tour;
+  json["pairs"] = nlohmann::json::array();
+  for (const auto& entry : m_entries) {
+    const path_t& path = entry.second.path;
+    std::vector<edge_index_t> edges;
+    edges.reserve(path.size());
+    for (const DirectedEdge& edge : path) {
+      edges.push_back(edge.edge);
+    }
+    json["pairs"].push_back({{"from", entry.first.first},
+                             {"to", entry.first.second},
+                             {"distance", entry.second.distance},
+                             {"start", path.empty() ? 0 : path[0].source},
+                             {"edges", edges}});
+  }
+
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open matrix cache " << filename
+              << std::endl;
+    return false;
+  }
+  file << json.dump() << std::endl;
+  return true;
+}
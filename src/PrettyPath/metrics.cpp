@@ -0,0 +1,156 @@
+#include "metrics.hh"
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace Metrics {
+
+namespace {
+
+constexpr size_t num_counters = static_cast<size_t>(Counter::Count);
+constexpr size_t num_phases = static_cast<size_t>(Phase::Count);
+
+const char* counter_names[num_counters] = {
+    "queries", "nodes_expanded", "edges_relaxed", "queue_pushes",
+    "stale_pops"};
+const char* phase_names[num_phases] = {"load", "snapping", "matrix",
+                                       "optimization", "write"};
+
+struct slots_t {
+  std::atomic<uint64_t> counters[num_counters] = {};
+};
+
+// A thread's slot is handed to a later thread once it exits, keeping its
+// counts, so totals include exited threads and there are only ever as many
+// slots as threads running at once
+std::mutex registry_mutex;
+std::deque<slots_t> registry;
+std::vector<slots_t*> free_slots;
+
+// Totals when last reset, counted from
+uint64_t reset_totals[num_counters] = {};
+
+std::atomic<uint64_t> phase_nanoseconds[num_phases] = {};
+std::atomic<uint64_t> phase_calls[num_phases] = {};
+
+// Holds the slot of a thread while it runs
+class SlotOwner {
+ public:
+  SlotOwner() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (free_slots.empty()) {
+      registry.emplace_back();
+      m_slots = &registry.back();
+    } else {
+      m_slots = free_slots.back();
+      free_slots.pop_back();
+    }
+  }
+  ~SlotOwner() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    free_slots.push_back(m_slots);
+  }
+  SlotOwner(const SlotOwner&) = delete;
+  SlotOwner& operator=(const SlotOwner&) = delete;
+
+  slots_t& slots() { return *m_slots; }
+
+ private:
+  slots_t* m_slots;
+};
+
+slots_t& local_slots() {
+  thread_local SlotOwner owner;
+  return owner.slots();
+}
+
+// Summed over every slot since the start, callers hold registry_mutex
+uint64_t lifetime_total(const size_t counter) {
+  uint64_t sum = 0;
+  for (const slots_t& slots : registry) {
+    sum += slots.counters[counter].load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+}  // namespace
+
+void add(const Counter counter, const uint64_t value) {
+  // Only this thread writes its slot, no read-modify-write needed
+  std::atomic<uint64_t>& slot =
+      local_slots().counters[static_cast<size_t>(counter)];
+  slot.store(slot.load(std::memory_order_relaxed) + value,
+             std::memory_order_relaxed);
+}
+
+uint64_t total(const Counter counter) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  const size_t i = static_cast<size_t>(counter);
+  return lifetime_total(i) - reset_totals[i];
+}
+
+void add_time(const Phase phase, const std::chrono::nanoseconds time) {
+  phase_nanoseconds[static_cast<size_t>(phase)].fetch_add(
+      time.count(), std::memory_order_relaxed);
+  phase_calls[static_cast<size_t>(phase)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+double seconds(const Phase phase) {
+  return phase_nanoseconds[static_cast<size_t>(phase)].load(
+             std::memory_order_relaxed) /
+         1e9;
+}
+
+uint64_t calls(const Phase phase) {
+  return phase_calls[static_cast<size_t>(phase)].load(
+      std::memory_order_relaxed);
+}
+
+void reset() {
+  // Slots are only written by their threads, so counting from the current
+  // totals loses nothing a search adds meanwhile
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (size_t i = 0; i < num_counters; i++) {
+    reset_totals[i] = lifetime_total(i);
+  }
+  for (size_t i = 0; i < num_phases; i++) {
+    phase_nanoseconds[i].store(0, std::memory_order_relaxed);
+    phase_calls[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+std::string to_json() {
+  nlohmann::json json;
+  const uint64_t queries = total(Counter::Queries);
+  for (size_t i = 0; i < num_counters; i++) {
+    const uint64_t value = total(static_cast<Counter>(i));
+    json["counters"][counter_names[i]] = value;
+    if (i != static_cast<size_t>(Counter::Queries) && queries > 0) {
+      json["per_query"][counter_names[i]] =
+          static_cast<double>(value) / queries;
+    }
+  }
+  for (size_t i = 0; i < num_phases; i++) {
+    json["phases"][phase_names[i]] = {
+        {"seconds", seconds(static_cast<Phase>(i))},
+        {"calls", calls(static_cast<Phase>(i))}};
+  }
+  return json.dump(2);
+}
+
+bool write_json(const std::string& filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open metrics file " << filename
+              << std::endl;
+    return false;
+  }
+  file << to_json() << std::endl;
+  return true;
+}
+
+}  // namespace Metrics
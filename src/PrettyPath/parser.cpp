@@ -1,5 +1,8 @@
 #include "parser.hh"
+#include <charconv>
+#include <cmath>
 #include <filesystem>
+#include <future>
 #include <nlohmann/json.hpp>
 
 // Allocate memory for static variables
@@ -29,7 +32,8 @@ std::vector<node_id_t> Parser::parse_nodes(
 }
 
 MapData Parser::read_map_data(Graph& graph) {
-  MapData map_data;  // Map node id to node
+  MapData map_data;
+  NodeStore& nodes = map_data.get_store();
 
   std::cout << "Reading map data\n";
 
@@ -65,11 +69,13 @@ MapData Parser::read_map_data(Graph& graph) {
     std::getline(ss, field);
     float elevation = std::stof(field);
 
-    const Node* node = new Node(id, latitude, longitude, elevation);
-    map_data.insert(std::make_pair(id, node));
+    nodes.add(id, latitude, longitude, elevation);
   }
 
   nodes_file.close();
+  nodes.sort_by_id();
+  graph.set_projection(
+      utils::LocalProjection(m_min_lat, m_max_lat, m_min_lon, m_max_lon));
 
   std::ifstream edges_file(m_edges_filename);
   if (!edges_file.is_open()) {
@@ -77,7 +83,10 @@ MapData Parser::read_map_data(Graph& graph) {
     return map_data;
   }
 
-  std::getline(edges_file, line);  // Skip the header
+  // Older files only carry the net slope, without ascent and descent
+  std::getline(edges_file, line);
+  const bool has_ascent = line.find(",ascent,descent,") != std::string::npos;
+  std::vector<node_index_t> geometry;  // Dense indices of the edge's nodes
   while (std::getline(edges_file, line)) {
     std::stringstream ss(line);
     std::string field;
@@ -106,6 +115,16 @@ MapData Parser::read_map_data(Graph& graph) {
     std::getline(ss, field, ',');
     double slope = std::stod(field);
 
+    // Get the ascent and descent from source to target
+    float ascent = std::max(0.0, slope * length);
+    float descent = std::max(0.0, -slope * length);
+    if (has_ascent) {
+      std::getline(ss, field, ',');
+      ascent = std::stof(field);
+      std::getline(ss, field, ',');
+      descent = std::stof(field);
+    }
+
     // Get the difficulty
     std::getline(ss, field, ',');
     int difficulty = std::stoi(field);
@@ -120,25 +139,44 @@ MapData Parser::read_map_data(Graph& graph) {
     std::getline(ss, field);
     auto edge_nodes = parse_nodes(field);
 
-    if (map_data.find(source_node_id) == map_data.end() ||
-        map_data.find(target_node_id) == map_data.end()) {
+    const Node start_node = map_data.find(source_node_id);
+    const Node target_node = map_data.find(target_node_id);
+    if (!start_node || !target_node) {
       std::cerr << "Error: Edge node not found in map data for edge: " << osm_id
                 << std::endl;
       continue;
     }
+    geometry.clear();
+    for (const node_id_t edge_node_id : edge_nodes) {
+      const node_index_t index = nodes.find(edge_node_id);
+      if (index == nodes.size()) break;
+      geometry.push_back(index);
+    }
+    if (geometry.size() != edge_nodes.size()) {
+      std::cerr << "Error: Geometry node not found in map data for edge: "
+                << osm_id << std::endl;
+      continue;
+    }
+    // Store the geometry in the source to target direction
+    if (geometry.front() != start_node.get_index()) {
+      std::reverse(geometry.begin(), geometry.end());
+    }
     if (source_node_id == target_node_id) {
       std::cerr << "Error: Source and Target node of edge: " << osm_id
                 << " are the same!" << std::endl;
     }
-    const Node* start_node = map_data[source_node_id];
-    const Node* target_node = map_data[target_node_id];
-    graph.add_edge(start_node, target_node, length, slope, car, osm_id,
-                   edge_nodes);
+    graph.add_edge(start_node, target_node, length, ascent, descent, car,
+                   difficulty, osm_id, geometry);
   }
 
   edges_file.close();
+  graph.build_segment_index(nodes);
 
   std::cout << "Done reading map data\n";
+  std::cout << "Stored " << nodes.size() << " nodes in "
+            << nodes.memory_usage() / 1024 << " KiB, edge geometry in "
+            << graph.geometry_memory_usage() / 1024 << " KiB, indexed "
+            << graph.num_segments() << " edge segments" << std::endl;
   std::cout << "Latitude range: " << m_min_lat << " -> " << m_max_lat
             << std::endl;
   std::cout << "Longitude range: " << m_min_lon << " -> " << m_max_lon
@@ -146,15 +184,18 @@ MapData Parser::read_map_data(Graph& graph) {
   return map_data;
 }
 
-std::vector<POIData> Parser::read_poi_data(const std::string& filename) {
-  std::vector<POIData> poi_data;
+namespace {
 
+// Calls add(poi) for each row of a POI csv, reusing one POIData throughout
+template <typename F>
+void read_poi_rows(const std::string& filename, F&& add) {
   std::ifstream poi_file(filename);
   if (!poi_file.is_open()) {
     std::cerr << "Error: Could not open file " << filename << std::endl;
-    return poi_data;
+    return;
   }
 
+  POIData poi;
   std::string line;
   std::getline(poi_file, line);  // Skip the header
   while (std::getline(poi_file, line)) {
@@ -163,44 +204,50 @@ std::vector<POIData> Parser::read_poi_data(const std::string& filename) {
 
     // Get the osm_id
     std::getline(ss, field, ',');
-    long osm_id = std::stol(field);
+    poi.osm_id = std::stol(field);
 
     // Get the name
     std::getline(ss, field, '"');
-    std::getline(ss, field, '"');
-    std::string name = field;
+    std::getline(ss, poi.name, '"');
     std::getline(ss, field, ',');
 
     // Get the latitude
     std::getline(ss, field, ',');
-    double latitude = std::stod(field);
+    poi.latitude = std::stod(field);
 
     // Get the longitude
     std::getline(ss, field, ',');
-    double longitude = std::stod(field);
+    poi.longitude = std::stod(field);
 
     // Get the elevation
     std::getline(ss, field, ',');
-    float elevation = std::stof(field);
-
-    if (ss.eof()) {
-      poi_data.push_back(POIData(name, latitude, longitude, osm_id, elevation));
-      continue;
-    }
+    poi.elevation = std::stof(field);
 
     // Get the area (if available)
-    std::getline(ss, field);
-    unsigned long area = std::stoul(field);
-
-    poi_data.push_back(
-        POIData(name, latitude, longitude, osm_id, elevation, area));
+    poi.area = 0;
+    if (!ss.eof()) {
+      std::getline(ss, field);
+      poi.area = std::stoul(field);
+    }
+    add(poi);
   }
+}
 
-  poi_file.close();
+}  // namespace
 
+std::vector<POIData> Parser::read_poi_data(const std::string& filename) {
+  std::vector<POIData> poi_data;
+  read_poi_rows(filename,
+                [&](const POIData& poi) { poi_data.push_back(poi); });
   return poi_data;
 }
 
+void Parser::read_poi_catalogue(const std::string& filename,
+                                const POIKind kind, POICatalogue& catalogue) {
+  read_poi_rows(filename,
+                [&](const POIData& poi) { catalogue.add(poi, kind); });
+}
+
 std::vector<POIData> Parser::read_ordered_poi_data(
     const std::string& filename) {
   std::vector<POIData> poi_data;
@@ -234,192 +281,603 @@ std::vector<POIData> Parser::read_ordered_poi_data(
   return poi_data;
 }
 
-std::vector<std::pair<const long, const Node*>> Parser::path_to_node_list(
-    const MapData& map_data, const Graph& graph,
-    const std::vector<const Node*>& path) {
-  std::vector<std::pair<const long, const Node*>> node_list;
-
-  for (size_t i = 1; i < path.size(); i++) {
-    const Node* node = path[i - 1];
-    const Node* next_node = path[i];
-    bool found_edge = false;
-    if (node == nullptr) {
-      std::cerr << "Error: Node is null" << std::endl;
+std::vector<std::pair<const long, Node>> Parser::path_to_node_list(
+    const MapData& map_data, const Graph& graph, const path_t& path) {
+  std::vector<std::pair<const long, Node>> node_list;
+  std::vector<node_index_t> edge_nodes;  // Geometry of the current edge
+
+  for (size_t i = 0; i < path.size(); i++) {
+    const DirectedEdge& directed = path[i];
+    const Edge& edge = graph.get_edge(directed.edge);
+    const auto geometry = graph.get_geometry(directed.edge);
+    edge_nodes.assign(geometry.begin(), geometry.end());
+    if (edge_nodes.empty()) {
+      std::cerr << "Error: Edge has no geometry" << std::endl;
       continue;
     }
-    if (next_node == nullptr) {
-      std::cerr << "Error: Next node is null" << std::endl;
-      continue;
+    // Geometry is stored source to target, flip it when walked backwards
+    if (directed.source != edge.get_source()) {
+      std::reverse(edge_nodes.begin(), edge_nodes.end());
     }
-    if (node == next_node) {
+    // Check the end node of the edge is the same as the next node
+    if (graph.get_node(directed.target).get_id() !=
+        map_data.get_node(edge_nodes.back()).get_id()) {
+      std::cerr << "Error: Next node is not the end node of the edge"
+                << std::endl;
       continue;
     }
+    if (i + 1 < path.size()) {  // If not the last edge in the path
+      edge_nodes.pop_back();  // Remove the end node from the edge (Prevent
+                              // duplicate nodes in the path)
+    }
+    const long edge_id = edge.get_osm_id();
+    for (const node_index_t edge_node : edge_nodes) {
+      node_list.push_back(
+          std::make_pair(edge_id, map_data.get_node(edge_node)));
+    }
+  }
+
+  return node_list;
+}
+
+namespace {
+
+// Numbers are formatted like the iostream writers did (std::fixed with 6
+// decimals), but straight into the output buffer
+void append_number(std::string& buffer, const double value,
+                   const int precision = 6) {
+  char chars[64];
+  const auto result = std::to_chars(chars, chars + sizeof(chars), value,
+                                    std::chars_format::fixed, precision);
+  buffer.append(chars, result.ptr);
+}
+
+void append_number(std::string& buffer, const long value) {
+  char chars[24];
+  const auto result = std::to_chars(chars, chars + sizeof(chars), value);
+  buffer.append(chars, result.ptr);
+}
+
+// Quoted JSON string, escaping quotes, backslashes and control characters
+void append_json_string(std::string& buffer, const std::string& value) {
+  buffer += '"';
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      buffer += '\\';
+      buffer += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char chars[8];
+      snprintf(chars, sizeof(chars), "\\u%04x", c);
+      buffer += chars;
+    } else {
+      buffer += c;
+    }
+  }
+  buffer += '"';
+}
+
+void append_stats(std::string& json, const RouteStats::stats_t& stats) {
+  json += "{\"length\":";
+  append_number(json, stats.length, 1);
+  json += ",\"ascent\":";
+  append_number(json, stats.ascent, 1);
+  json += ",\"descent\":";
+  append_number(json, stats.descent, 1);
+  json += ",\"ascent_length\":";
+  append_number(json, stats.ascent_length, 1);
+  json += ",\"descent_length\":";
+  append_number(json, stats.descent_length, 1);
+  json += ",\"flat_length\":";
+  append_number(json, stats.flat_length, 1);
+  json += ",\"time\":";
+  append_number(json, stats.time, 0);
+  json += ",\"grades\":[";
+  for (size_t i = 0; i < stats.grade_lengths.size(); i++) {
+    if (i > 0) json += ',';
+    append_number(json, stats.grade_lengths[i], 1);
+  }
+  json += "]}";
+}
+
+// Where a snapped point lies on its edge's geometry, listed source to
+// target: the nodes before index before and from index after on are either
+// side of it
+struct snapped_point_t {
+  Node node;  // The geometry node itself when the point lies on one
+  long edge_id = 0;
+  node_index_t source = 0;  // Of the edge, in the graph
+  double fraction = 0;
+  std::vector<node_index_t> geometry;
+  size_t before = 0, after = 0;
+};
+
+// Points between geometry nodes are interpolated into points
+snapped_point_t locate_snap(const MapData& map_data, const Graph& graph,
+                            const snap_t& snap, NodeStore& points) {
+  snapped_point_t point;
+  if (!snap) {
+    return point;
+  }
+  const auto geometry = graph.get_geometry(snap.edge);
+  point.geometry.assign(geometry.begin(), geometry.end());
+  if (point.geometry.size() < 2) {
+    return snapped_point_t();
+  }
+  point.edge_id = graph.get_edge(snap.edge).get_osm_id();
+  point.source = graph.get_edge(snap.edge).get_source();
+  point.fraction = snap.fraction;
+
+  // Projected lengths along the geometry, as the fraction was measured
+  std::vector<double> offsets;
+  std::pair<float, float> previous;
+  for (const node_index_t index : point.geometry) {
+    const auto location = map_data.get_node(index).get_location();
+    const auto next =
+        graph.get_projection().project(location.first, location.second);
+    offsets.push_back(offsets.empty()
+                          ? 0
+                          : offsets.back() +
+                                std::hypot(next.first - previous.first,
+                                           next.second - previous.second));
+    previous = next;
+  }
+  const double along = snap.fraction * offsets.back();
+  size_t k = 0;
+  while (k + 2 < offsets.size() && offsets[k + 1] <= along) k++;
+  const double length = offsets[k + 1] - offsets[k];
+
+  // Within a centimetre of a geometry node the point is that node
+  const double min_length = 0.01;
+  if (along - offsets[k] < min_length) {
+    point.node = map_data.get_node(point.geometry[k]);
+    point.before = k;
+    point.after = k + 1;
+    return point;
+  }
+  if (offsets[k + 1] - along < min_length) {
+    point.node = map_data.get_node(point.geometry[k + 1]);
+    point.before = k + 1;
+    point.after = k + 2;
+    return point;
+  }
+  const double t = (along - offsets[k]) / length;
+  const Node from = map_data.get_node(point.geometry[k]);
+  const Node to = map_data.get_node(point.geometry[k + 1]);
+  const auto a = from.get_location(), b = to.get_location();
+  const node_index_t index =
+      points.add(0, a.first + t * (b.first - a.first),
+                 a.second + t * (b.second - a.second),
+                 from.get_elevation() +
+                     t * (to.get_elevation() - from.get_elevation()));
+  point.node = Node(&points, index);
+  point.before = point.after = k + 1;
+  return point;
+}
 
-    // Find the edge between node and next_node
-    for (const auto& edge_pair : graph.get_neighbours(node)) {
-      if (edge_pair.first == next_node) {
-        found_edge = true;
-        Edge edge = edge_pair.second;
-        // Check if the edge is in the correct direction
-        edge.reverse_if_needed(node->get_id());
-        auto edge_nodes = edge.get_edge_nodes();
-        // Check the end node of the edge is the same as the next node
-        if (next_node->get_id() != edge_nodes.back()) {
-          std::cerr << "Error: Next node is not the end node of the edge"
-                    << std::endl;
-          continue;
-        }
-        if (next_node != path.back()) {  // If not the last node in the path
-          edge_nodes.pop_back();  // Remove the end node from the edge (Prevent
-                                  // duplicate nodes in the path)
-        }
-        const long edge_id = edge.get_osm_id();
-        for (auto it = edge_nodes.begin(); it != edge_nodes.end(); it++) {
-          const Node* edge_node = map_data.at(*it);
-          node_list.push_back(std::make_pair(edge_id, edge_node));
-        }
-        break;
+// Nodes of a leg from one snapped point to the next: along the first
+// point's edge to where the leg joins the graph, its whole edges, and along
+// the second point's edge to it. Where the legs either side of a point join
+// its edge at the same end, the route goes out to the point and back.
+std::vector<std::pair<const long, Node>> leg_to_node_list(
+    const MapData& map_data, const Graph& graph,
+    const Pathfinder::snapped_path_t& leg, const snapped_point_t& from,
+    const snapped_point_t& to) {
+  if (!leg.found || !from.node || !to.node) {
+    return Parser::path_to_node_list(map_data, graph, leg.path);
+  }
+  // A repeated node keeps the later edge, the one leaving it
+  std::vector<std::pair<const long, Node>> node_list;
+  auto append = [&](const long edge_id, const Node node) {
+    if (!node_list.empty() && node_list.back().second == node) {
+      node_list.pop_back();
+    }
+    node_list.emplace_back(edge_id, node);
+  };
+  auto append_geometry = [&](const snapped_point_t& point, const size_t i) {
+    append(point.edge_id, map_data.get_node(point.geometry[i]));
+  };
+
+  append(from.edge_id, from.node);
+  if (leg.first == Pathfinder::no_node) {
+    // Straight along the edge both points lie on
+    if (to.fraction >= from.fraction) {
+      for (size_t i = from.after; i < to.before; i++) {
+        append_geometry(from, i);
+      }
+    } else {
+      for (size_t i = from.before; i > to.after; i--) {
+        append_geometry(from, i - 1);
+      }
+    }
+  } else {
+    if (leg.first == from.source) {
+      for (size_t i = from.before; i > 0; i--) {
+        append_geometry(from, i - 1);
+      }
+    } else {
+      for (size_t i = from.after; i < from.geometry.size(); i++) {
+        append_geometry(from, i);
       }
     }
-    if (!found_edge) {
-      std::cerr << "Error: Edge not found between " << node->get_id() << " and "
-                << next_node->get_id() << std::endl;
+    for (const auto& pair : Parser::path_to_node_list(map_data, graph,
+                                                       leg.path)) {
+      append(pair.first, pair.second);
+    }
+    if (leg.last == to.source) {
+      for (size_t i = 0; i < to.before; i++) {
+        append_geometry(to, i);
+      }
+    } else {
+      for (size_t i = to.geometry.size(); i > to.after; i--) {
+        append_geometry(to, i - 1);
+      }
     }
   }
-
+  append(to.edge_id, to.node);
   return node_list;
 }
 
-void Parser::write_path_to_py(
-    const std::vector<std::pair<const long, const Node*>>& node_list,
-    const std::string& filename) {
-  std::ofstream file(filename);
-  long node_counter = 0;
+}  // namespace
+
+double Parser::write_path_to_py(
+    const std::vector<std::pair<const long, Node>>& node_list,
+    std::string& csv, RouteStats::Accumulator& stats) {
   double total_length = 0;
+  double previous_length = 0;  // Of the segment to this node
+  csv.reserve(csv.size() + 64 * (node_list.size() + 1));
 
-  file << "id,lat,lon,length,elevation\n";
-  file << std::fixed << std::setprecision(6);
+  csv += "id,lat,lon,length,elevation\n";
 
   for (auto it = node_list.begin(); it != node_list.end(); it++) {
     const long edge_id = it->first;
-    const Node* node = it->second;
-    const Node* next_node =
-        (it + 1 != node_list.end()) ? (it + 1)->second : nullptr;
-    const auto location = node->get_location();
+    const Node node = it->second;
+    const Node next_node =
+        (it + 1 != node_list.end()) ? (it + 1)->second : Node();
+    const auto location = node.get_location();
     double length = 0;
-    if (next_node != nullptr) {
-      const auto next_location = next_node->get_location();
-      length = node->distance_to(next_location.first, next_location.second);
+    if (next_node) {
+      const auto next_location = next_node.get_location();
+      length = node.distance_to(next_location.first, next_location.second);
     }
-    file << edge_id << "," << location.first << "," << location.second << ","
-         << length << "," << node->get_elevation() << "\n";
-    node_counter++;
+    append_number(csv, edge_id);
+    csv += ',';
+    append_number(csv, location.first);
+    csv += ',';
+    append_number(csv, location.second);
+    csv += ',';
+    append_number(csv, length);
+    csv += ',';
+    append_number(csv, node.get_elevation());
+    csv += '\n';
+    stats.add(previous_length, node.get_elevation());
+    previous_length = length;
     total_length += length;
   }
 
-  file.close();
-  std::cout << "Wrote " << node_counter << " nodes to " << filename
-            << std::endl;
-  std::cout << "Total length: " << total_length / 1000.f << " km" << std::endl;
+  return total_length;
 }
 
-std::ofstream Parser::write_gpx_header(const std::string& file_name) {
-  std::ofstream file(file_name);
-  file << std::fixed << std::setprecision(6);
-
-  file << R"(<?xml version="1.0" encoding="UTF-8" standalone="no" ?>)"
-       << "\n";
-  file
-      << R"(<gpx xmlns="http://www.topografix.com/GPX/1/1" creator="PrettyPath" version="1.1" xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance" xsi:schemaLocation="http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd">)"
-      << "\n";
-
-  return file;
+void Parser::write_gpx_header(std::string& gpx) {
+  gpx += R"(<?xml version="1.0" encoding="UTF-8" standalone="no" ?>)";
+  gpx += "\n";
+  gpx +=
+      R"(<gpx xmlns="http://www.topografix.com/GPX/1/1" creator="PrettyPath" version="1.1" xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance" xsi:schemaLocation="http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd">)";
+  gpx += "\n";
 }
 
-void Parser::write_gpx_waypoint(std::ofstream& file, const std::string& name,
+void Parser::write_gpx_waypoint(std::string& gpx, const std::string& name,
                                 const double lat, const double lon,
                                 const double elevation) {
-  file << "<wpt lat=\"" << lat << "\" lon=\"" << lon << "\">\n";
-  file << "<name>" << name << "</name>\n";
-  file << "<ele>" << elevation << "</ele>\n";
-  file << "</wpt>\n";
+  gpx += "<wpt lat=\"";
+  append_number(gpx, lat);
+  gpx += "\" lon=\"";
+  append_number(gpx, lon);
+  gpx += "\">\n<name>" + name + "</name>\n<ele>";
+  append_number(gpx, elevation);
+  gpx += "</ele>\n</wpt>\n";
 }
 
 void Parser::write_gpx_track_segment(
-    std::ofstream& file, const std::string& name,
-    const std::vector<std::pair<const long, const Node*>>& node_list) {
-  file << "<trk>\n";
-  file << "<name>" << name << "</name>\n";
-  file << "<trkseg>\n";
+    std::string& gpx, const std::string& name,
+    const std::vector<std::pair<const long, Node>>& node_list) {
+  gpx.reserve(gpx.size() + 80 * node_list.size() + 128);
+  gpx += "<trk>\n<name>" + name + "</name>\n<trkseg>\n";
   for (auto it = node_list.begin(); it != node_list.end(); it++) {
-    const Node* node = it->second;
-    if (node == nullptr) {
+    const Node node = it->second;
+    if (!node) {
       std::cerr << "Error: Node is null" << std::endl;
       continue;
     }
-    const auto location = node->get_location();
+    const auto location = node.get_location();
+
+    gpx += "<trkpt lat=\"";
+    append_number(gpx, location.first);
+    gpx += "\" lon=\"";
+    append_number(gpx, location.second);
+    gpx += "\">\n<ele>";
+    append_number(gpx, node.get_elevation());
+    gpx += "</ele>\n</trkpt>\n";
+  }
+  gpx += "</trkseg>\n</trk>\n";
+}
+
+void Parser::write_gpx_footer(std::string& gpx) { gpx += "</gpx>\n"; }
+
+void Parser::write_route_json(
+    std::string& json, const Graph& graph,
+    const std::vector<std::pair<const POIData, size_t>>& pois,
+    const std::vector<Node>& route, const std::vector<size_t>& leg_starts,
+    const RouteStats::route_t& stats, const Config::route_output_t& options) {
+  std::vector<std::pair<double, double>> locations;
+  std::vector<std::pair<float, float>> points;  // Projected, in m
+  std::vector<double> distances;  // Along the route, in m
+  locations.reserve(route.size());
+  points.reserve(route.size());
+  distances.reserve(route.size());
+  double distance = 0;
+  for (size_t i = 0; i < route.size(); i++) {
+    const auto location = route[i].get_location();
+    if (i > 0) distance += route[i - 1].distance_to(location.first,
+                                                    location.second);
+    distances.push_back(distance);
+    locations.push_back(location);
+    points.push_back(
+        graph.get_projection().project(location.first, location.second));
+  }
+  const double length = distance;
+
+  std::vector<std::pair<double, double>> kept;
+  auto append_polyline = [&](const std::vector<size_t>& indices) {
+    kept.clear();
+    for (const size_t index : indices) kept.push_back(locations[index]);
+    std::string polyline;
+    Polyline::encode(polyline, kept);
+    append_json_string(json, polyline);
+  };
+
+  json += "{\"length\":";
+  append_number(json, length, 1);
+
+  json += ",\"waypoints\":[";
+  for (size_t i = 0; i < pois.size(); i++) {
+    const POIData& poi = pois[i].first;
+    const size_t start = i < leg_starts.size() ? leg_starts[i] : route.size();
+    json += i == 0 ? "{\"name\":" : ",{\"name\":";
+    append_json_string(json, poi.name);
+    json += ",\"lat\":";
+    append_number(json, poi.latitude);
+    json += ",\"lon\":";
+    append_number(json, poi.longitude);
+    json += ",\"ele\":";
+    append_number(json, poi.elevation, 1);
+    json += ",\"distance\":";
+    append_number(json, start < distances.size() ? distances[start] : length,
+                  1);
+    json += '}';
+  }
+
+  // One polyline per zoom level, coarser levels for smaller map scales
+  json += "],\"levels\":[";
+  for (size_t i = 0; i < options.tolerances.size(); i++) {
+    const auto indices = Polyline::simplify(points, options.tolerances[i]);
+    json += i == 0 ? "{\"tolerance\":" : ",{\"tolerance\":";
+    append_number(json, options.tolerances[i], 1);
+    json += ",\"points\":";
+    append_number(json, static_cast<long>(indices.size()));
+    json += ",\"polyline\":";
+    append_polyline(indices);
+    json += '}';
+  }
+
+  // Elevation against distance, simplified in the same way
+  std::vector<std::pair<float, float>> profile;
+  profile.reserve(route.size());
+  for (size_t i = 0; i < route.size(); i++) {
+    profile.push_back(std::make_pair(distances[i], route[i].get_elevation()));
+  }
+  const auto indices =
+      Polyline::simplify(profile, options.elevation_tolerance);
+  json += "],\"profile\":{\"tolerance\":";
+  append_number(json, options.elevation_tolerance, 1);
+  json += ",\"distance\":[";
+  for (size_t i = 0; i < indices.size(); i++) {
+    if (i > 0) json += ',';
+    append_number(json, distances[indices[i]], 1);
+  }
+  json += "],\"elevation\":[";
+  for (size_t i = 0; i < indices.size(); i++) {
+    if (i > 0) json += ',';
+    append_number(json, route[indices[i]].get_elevation(), 1);
+  }
+  json += "],\"polyline\":";
+  append_polyline(indices);
+
+  // Legs in waypoint order, grades binned by options.stats.grade_bins
+  json += "},\"stats\":{\"ascent_threshold\":";
+  append_number(json, options.stats.ascent_threshold, 1);
+  json += ",\"grade_bins\":[";
+  for (size_t i = 0; i < options.stats.grade_bins.size(); i++) {
+    if (i > 0) json += ',';
+    append_number(json, options.stats.grade_bins[i], 1);
+  }
+  json += "],\"total\":";
+  append_stats(json, stats.total);
+  json += ",\"legs\":[";
+  for (size_t i = 0; i < stats.legs.size(); i++) {
+    if (i > 0) json += ',';
+    append_stats(json, stats.legs[i]);
+  }
+  json += "]}}\n";
+}
 
-    file << "<trkpt lat=\"" << location.first << "\" lon=\"" << location.second
-         << "\">\n";
-    file << "<ele>" << node->get_elevation() << "</ele>\n";
-    file << "</trkpt>\n";
+bool Parser::write_isochrone(const Graph& graph,
+                             const Pathfinder::isochrone_t& isochrone,
+                             const std::string& filename) {
+  // The furthest node reached in each direction from the source traces the
+  // reachable area, following valleys and ridges a convex hull would span
+  const int num_sectors = 72;
+  std::vector<node_index_t> furthest(num_sectors, Pathfinder::no_node);
+  std::vector<float> furthest_distance(num_sectors, -1);
+  long reached = 0;
+  for (node_index_t node = 0; node < graph.num_nodes(); node++) {
+    if (isochrone.distances[node] > isochrone.radius) continue;
+    reached++;
+    const auto location = graph.get_projected_location(node);
+    const float dx = location.first - isochrone.source.x;
+    const float dy = location.second - isochrone.source.y;
+    const int sector = std::min<int>(
+        (std::atan2(dy, dx) + M_PI) / (2 * M_PI) * num_sectors,
+        num_sectors - 1);
+    if (dx * dx + dy * dy > furthest_distance[sector]) {
+      furthest_distance[sector] = dx * dx + dy * dy;
+      furthest[sector] = node;
+    }
   }
-  file << "</trkseg>\n";
-  file << "</trk>\n";
+  std::vector<std::pair<double, double>> outline;
+  for (const node_index_t node : furthest) {
+    if (node != Pathfinder::no_node) {
+      outline.push_back(graph.get_node(node).get_location());
+    }
+  }
+  if (!outline.empty()) outline.push_back(outline.front());  // Closed
+
+  std::string json = "{\"radius\":";
+  append_number(json, isochrone.radius, 1);
+  json += ",\"nodes\":";
+  append_number(json, reached);
+  json += ",\"polygon\":";
+  std::string polygon;
+  Polyline::encode(polygon, outline);
+  append_json_string(json, polygon);
+  json += "}\n";
+  return write_file(filename, json);
 }
 
-void Parser::write_gpx_footer(std::ofstream& file) {
-  file << "</gpx>\n";
-  file.close();
+bool Parser::write_file(const std::string& filename,
+                        const std::string& contents) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open file " << filename << std::endl;
+    return false;
+  }
+  file.write(contents.data(), contents.size());
+  return true;
 }
 
-void Parser::write_paths(
+RouteStats::route_t Parser::write_paths(
     const MapData& map_data, const Graph& graph,
-    const std::pair<std::vector<std::pair<const POIData, size_t>>,
-                    std::vector<const Node*>>& poi_path,
-    const std::string& file_dir, const std::string& gpx_filename) {
-  auto pois = poi_path.first;
-  auto path = poi_path.second;
-  size_t path_start = 0;
-  size_t edges_written = 0;
-
+    const std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>&
+        poi_path,
+    const std::string& file_dir, const std::string& gpx_filename,
+    const std::string& route_filename,
+    const Config::route_output_t& route_output) {
+  Metrics::ScopedTimer timer(Metrics::Phase::Write);
+  const auto& pois = poi_path.first;
+  const auto& path = poi_path.second;
+
+  // Only leg files from an earlier run are removed, anything else in the
+  // directory is left alone
+  std::filesystem::create_directories(file_dir);
   for (const auto& entry : std::filesystem::directory_iterator(file_dir)) {
-    std::filesystem::remove(entry);
+    if (entry.path().extension() == ".csv") {
+      std::filesystem::remove(entry);
+    }
   }
 
-  std::ofstream gpx = write_gpx_header(file_dir + gpx_filename);
+  struct leg_t {
+    std::string name, filename, gpx;
+    std::vector<std::pair<const long, Node>> node_list;
+    size_t num_nodes = 0;
+    double length = 0;
+    RouteStats::stats_t stats;
+  };
+
+  // Legs run from snapped point to snapped point, the ones between geometry
+  // nodes are added here
+  NodeStore points;
+  std::vector<snapped_point_t> snapped;
+  for (const auto& poi : pois) {
+    snapped.push_back(locate_snap(map_data, graph, poi.first.snap, points));
+  }
 
+  // Each leg is materialized, formatted and its CSV written on its own
+  // thread, the GPX is joined in order afterwards
+  std::vector<std::future<leg_t>> futures;
+  size_t path_start = 0;
   for (size_t i = 0; i < pois.size() - 1; i++) {
-    auto path_length = pois[i].second;
-    edges_written += path_length;
-    auto start_poi = pois[i].first;
-    auto end_poi = pois[(i + 1) % pois.size()].first;
-    std::cout << "Writing path from " << start_poi.name << " to "
-              << end_poi.name << " with " << path_length << " edges"
-              << std::endl;
-    std::string name = start_poi.name_without_spaces() + "_to_" +
-                       end_poi.name_without_spaces();
-    std::string filename = file_dir + name + ".csv";
-    std::vector<const Node*> sub_path(path.begin() + path_start,
-                                      path.begin() + path_start + path_length);
+    const size_t path_length = pois[i].second;
+    const size_t leg_start = path_start;
     path_start += path_length;
-    auto node_list = path_to_node_list(map_data, graph, sub_path);
+    futures.push_back(std::async(std::launch::async, [&, i, path_length,
+                                                      leg_start]() {
+      leg_t leg;
+      leg.name = pois[i].first.name_without_spaces() + "_to_" +
+                 pois[i + 1].first.name_without_spaces();
+      leg.filename = file_dir + leg.name + ".csv";
+      const auto sub_path = Pathfinder::join_snaps(
+          graph,
+          path_t(path.begin() + leg_start,
+                 path.begin() + leg_start + path_length),
+          pois[i].first.snap, pois[i + 1].first.snap);
+      leg.node_list = leg_to_node_list(map_data, graph, sub_path, snapped[i],
+                                       snapped[i + 1]);
+      std::string csv;
+      RouteStats::Accumulator stats(route_output.stats);
+      leg.length = write_path_to_py(leg.node_list, csv, stats);
+      leg.stats = stats.finish();
+      leg.num_nodes = leg.node_list.size();
+      write_file(leg.filename, csv);
+      write_gpx_track_segment(leg.gpx, leg.name, leg.node_list);
+      return leg;
+    }));
+  }
 
+  std::string gpx;
+  write_gpx_header(gpx);
+  std::vector<Node> route;  // Every leg joined, without repeated ends
+  std::vector<size_t> leg_starts;
+  RouteStats::route_t stats;
+  stats.total.grade_lengths.assign(route_output.stats.grade_bins.size() + 1,
+                                   0);
+  for (size_t i = 0; i < futures.size(); i++) {
+    const leg_t leg = futures[i].get();
+    stats.legs.push_back(leg.stats);
+    stats.total.add(leg.stats);
+    leg_starts.push_back(route.empty() ? 0 : route.size() - 1);
+    for (const auto& pair : leg.node_list) {
+      if (route.empty() || route.back() != pair.second) {
+        route.push_back(pair.second);
+      }
+    }
+    const auto& start_poi = pois[i].first;
+    std::cout << "Writing path from " << start_poi.name << " to "
+              << pois[i + 1].first.name << " with " << pois[i].second
+              << " edges" << std::endl;
+    std::cout << "Wrote " << leg.num_nodes << " nodes to " << leg.filename
+              << std::endl;
+    std::cout << "Total length: " << leg.length / 1000.f << " km, ascent "
+              << leg.stats.ascent << " m, descent " << leg.stats.descent
+              << " m, about " << leg.stats.time / 3600 << " h" << std::endl;
     write_gpx_waypoint(gpx, start_poi.name, start_poi.latitude,
                        start_poi.longitude, start_poi.elevation);
-
-    write_gpx_track_segment(gpx, name, node_list);
-    write_path_to_py(node_list, filename);
+    gpx += leg.gpx;
   }
   write_gpx_waypoint(gpx, pois.back().first.name, pois.back().first.latitude,
                      pois.back().first.longitude,
                      pois.back().first.elevation);
   write_gpx_footer(gpx);
+  write_file(file_dir + gpx_filename, gpx);
+
+  std::string json;
+  write_route_json(json, graph, pois, route, leg_starts, stats,
+                   route_output);
+  write_file(file_dir + route_filename, json);
+  std::cout << "Wrote " << gpx.size() / 1024 << " KiB GPX, "
+            << json.size() / 1024 << " KiB simplified route to "
+            << file_dir + route_filename << std::endl;
+  return stats;
 }
 
 void Parser::clean_map_data(MapData& map_data) {
-  for (auto& pair : map_data) {
-    delete pair.second;
-  }
   map_data.clear();
 }
\ No newline at end of file
@@ -2,278 +2,624 @@
 
 namespace Pathfinder {
 
-std::pair<double, const Node*> find_nearby_node(
-    const std::vector<const Node*> attempted_goals, const double variation,
-    const Graph& graph) {
-  const Node* nearby_node = nullptr;
-  double min_distance = std::numeric_limits<double>::max();
-  const Node* first_goal = attempted_goals.front();
-  const auto first_goal_location = first_goal->get_location();
-
-  graph.apply_to_nodes([&](const Node* node) {
-    bool is_attempted = false;
-    for (const Node* goal : attempted_goals) {
-      if (node == goal) {
-        is_attempted = true;
-        break;
-      }
-    }
-    if (is_attempted) {
-      return;
-    }
-    double distance = node->distance_to(first_goal_location.first,
-                                        first_goal_location.second);
+const double unvisited = std::numeric_limits<double>::max();
+
+// Adds the counts of one finished search to the metrics registry
+void record_search(const long searched_nodes, const long relaxed_edges,
+                   const long queue_pushes, const size_t stale_pops) {
+  Metrics::add(Metrics::Counter::Queries);
+  Metrics::add(Metrics::Counter::NodesExpanded, searched_nodes);
+  Metrics::add(Metrics::Counter::EdgesRelaxed, relaxed_edges);
+  Metrics::add(Metrics::Counter::QueuePushes, queue_pushes);
+  Metrics::add(Metrics::Counter::StalePops, stale_pops);
+}
 
-    if (distance < min_distance && distance >= variation) {
-      nearby_node = node;
-      min_distance = distance;
-    }
-  });
 
-  return std::make_pair(min_distance, nearby_node);
+path_t reconstruct_path(const Graph& graph,
+                        const std::vector<edge_index_t>& came_from,
+                        node_index_t current) {
+  path_t path;
+  while (came_from[current] != no_edge) {
+    const edge_index_t edge = came_from[current];
+    const node_index_t parent = graph.get_edge(edge).opposite(current);
+    path.push_back({edge, parent, current});
+    current = parent;
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+// Admissible estimate of the cost from node to goal: the larger of the
+// (projected) straight line distance at the profile's cheapest pace and the
+// landmark (ALT) lower bound
+double heuristic(const Graph& graph, const RoutingProfile& profile,
+                 const node_index_t node, const node_index_t goal) {
+  const double distance =
+      graph.projected_distance(node, goal) * profile.min_cost_per_metre();
+  const double landmark_bound =
+      profile.get_landmarks().lower_bound(node, goal);
+  return std::max(distance, landmark_bound);
 }
 
-std::pair<double, const Node*> find_nearby_connected_node(
-    const Node* const desired, const Node* connected_node,
-    const double variation, const Graph& graph) {
-  const auto desired_location = desired->get_location();
-  const Node* nearby_node = nullptr;
-  double min_distance = std::numeric_limits<double>::max();
-  std::vector<const Node*> attempted_nodes;
-
-  for (double radius = variation; radius < 10 * variation;
-       radius += variation) {
-    graph.apply_to_nodes([&](const Node* node) {
-      if (std::find(attempted_nodes.begin(), attempted_nodes.end(), node) !=
-          attempted_nodes.end()) {
-        return;
+// Single source shortest path costs to every node, indexed by node index, or
+// with reverse the costs from every node to the source. Nodes further than
+// max_cost (or unreachable) are left at max double.
+std::vector<double> dijkstra(const Graph& graph, const RoutingProfile& profile,
+                             const Node source, const double max_cost,
+                             const bool reverse) {
+  std::vector<double> distances(graph.num_nodes(),
+                                std::numeric_limits<double>::max());
+  Queue::DaryHeap<> open_set(graph.num_nodes());
+  const node_index_t source_index = graph.get_index(source);
+  distances[source_index] = 0;
+  open_set.push(source_index, 0);
+
+  while (!open_set.empty()) {
+    const node_index_t current = open_set.pop();
+    const double distance = distances[current];
+
+    for (const auto& pair : graph.get_neighbours(current)) {
+      const edge_index_t edge = pair.second;
+      if (profile.is_blocked(edge)) {
+        continue;
       }
-      double distance =
-          node->distance_to(desired_location.first, desired_location.second);
-      if (distance < radius && distance < min_distance) {
-        attempted_nodes.push_back(node);
-        if (is_connected(graph, node, connected_node)) {
-          nearby_node = node;
-          min_distance = distance;
-        }
+      const node_index_t neighbour = pair.first;
+      const double tentative_distance =
+          distance + profile.cost(edge, reverse ? neighbour : current);
+      if (tentative_distance > max_cost) {
+        continue;
+      }
+      if (tentative_distance < distances[neighbour]) {
+        distances[neighbour] = tentative_distance;
+        open_set.push(neighbour, tentative_distance);
       }
-    });
-    if (nearby_node != nullptr) {
-      break;
     }
   }
 
-  return std::make_pair(min_distance, nearby_node);
+  return distances;
 }
 
-std::vector<const Node*> reconstruct_path(
-    const std::unordered_map<const Node*, const Node*>& came_from,
-    const Node* current) {
-  std::vector<const Node*> path;
-  while (came_from.find(current) != came_from.end()) {
-    path.push_back(current);
-    current = came_from.at(current);
+isochrone_t isochrone(const Graph& graph, const RoutingProfile& profile,
+                      const snap_t& source, const double radius) {
+  isochrone_t result;
+  result.source = source;
+  result.radius = radius;
+  result.distances.assign(graph.num_nodes(), unvisited);
+  if (!source) {
+    return result;
   }
-  path.push_back(current);
-  std::reverse(path.begin(), path.end());
-  return path;
+
+  // Leave the source along both parts of its edge
+  Queue::DaryHeap<> open_set(graph.num_nodes());
+  const Edge& source_edge = graph.get_edge(source.edge);
+  const double to_source = source.fraction * source_edge.get_length();
+  const double to_target = source_edge.get_length() - to_source;
+  std::vector<double>& distances = result.distances;
+  if (to_source <= radius) {
+    distances[source_edge.get_source()] = to_source;
+    open_set.push(source_edge.get_source(), to_source);
+  }
+  if (to_target <= radius && to_target < distances[source_edge.get_target()]) {
+    distances[source_edge.get_target()] = to_target;
+    open_set.push(source_edge.get_target(), to_target);
+  }
+
+  while (!open_set.empty()) {
+    const node_index_t current = open_set.pop();
+    const double distance = distances[current];
+
+    for (const auto& pair : graph.get_neighbours(current)) {
+      const edge_index_t edge = pair.second;
+      if (profile.is_blocked(edge)) {
+        continue;
+      }
+      const node_index_t neighbour = pair.first;
+      const double tentative_distance =
+          distance + graph.get_edge(edge).get_length();
+      if (tentative_distance <= radius &&
+          tentative_distance < distances[neighbour]) {
+        distances[neighbour] = tentative_distance;
+        open_set.push(neighbour, tentative_distance);
+      }
+    }
+  }
+  return result;
 }
 
-void init(const Graph& graph, const Node* start, const Node* goal,
-          std::unordered_map<const Node*, const Node*>& came_from,
-          std::unordered_map<const Node*, double>& g_score,
-          std::unordered_map<const Node*, double>& f_score,
-          open_set_t& open_set, long& searched_nodes) {
-  searched_nodes = 0;
-  open_set.push(std::make_pair(0, start));
-
-  came_from.clear();
-  graph.apply_to_nodes([&](const Node* node) {
-    g_score[node] = std::numeric_limits<double>::infinity();
-  });
-  g_score[start] = 0;
-
-  graph.apply_to_nodes([&](const Node* node) {
-    f_score[node] = std::numeric_limits<double>::infinity();
-  });
-  f_score[start] = start->distance_to(goal->get_location().first,
-                                      goal->get_location().second);
+double isochrone_t::distance(const Graph& graph, const snap_t& snap) const {
+  if (!snap || !source) {
+    return unvisited;
+  }
+  const Edge& edge = graph.get_edge(snap.edge);
+  if (snap.edge == source.edge) {
+    return std::abs(snap.fraction - source.fraction) * edge.get_length();
+  }
+  double distance = unvisited;
+  if (distances[edge.get_source()] != unvisited) {
+    distance = distances[edge.get_source()] + snap.fraction * edge.get_length();
+  }
+  if (distances[edge.get_target()] != unvisited) {
+    distance = std::min(distance, distances[edge.get_target()] +
+                                      (1 - snap.fraction) * edge.get_length());
+  }
+  return distance;
 }
 
-bool is_connected(const Graph& graph, const Node* start, const Node* goal) {
-  // Bidirectional DFS
-  std::unordered_set<const Node*> visited_from_start;
-  std::unordered_set<const Node*> visited_from_goal;
-  std::stack<const Node*> stack_from_start;
-  std::stack<const Node*> stack_from_goal;
-  stack_from_start.push(start);
-  stack_from_goal.push(goal);
-  while (!stack_from_start.empty() && !stack_from_goal.empty()) {
-    if (visit_next_node(graph, stack_from_start, visited_from_start,
-                        visited_from_goal)) {
-      return true;
-    }
-    if (visit_next_node(graph, stack_from_goal, visited_from_goal,
-                        visited_from_start)) {
-      return true;
-    }
+namespace {
+
+// A temporary node for a search to start or end at, joined to the graph by
+// partial edges: a snapped point joined to both ends of its edge, or a node
+// of the graph joined to itself at no cost
+struct virtual_node_t {
+  node_index_t nodes[2];
+  double costs_to[2];    // From the virtual node to nodes[i]
+  double costs_from[2];  // From nodes[i] to the virtual node
+  edge_index_t edge = no_edge;
+  double fraction = 0;
+  float x, y;                    // Projected
+  std::vector<float> landmarks;  // As a row of Landmarks
+};
+
+virtual_node_t at_node(const Graph& graph, const RoutingProfile& profile,
+                       const node_index_t node) {
+  virtual_node_t point;
+  point.nodes[0] = point.nodes[1] = node;
+  point.costs_to[0] = point.costs_to[1] = 0;
+  point.costs_from[0] = point.costs_from[1] = 0;
+  const auto location = graph.get_projected_location(node);
+  point.x = location.first;
+  point.y = location.second;
+  point.landmarks = profile.get_landmarks().virtual_row(
+      point.nodes, point.costs_to, point.costs_from, 1);
+  return point;
+}
+
+// The partial edges cost their share of the edge in each direction
+virtual_node_t at_snap(const Graph& graph, const RoutingProfile& profile,
+                       const snap_t& snap) {
+  const Edge& edge = graph.get_edge(snap.edge);
+  virtual_node_t point;
+  point.nodes[0] = edge.get_source();
+  point.nodes[1] = edge.get_target();
+  const double forward = profile.cost(snap.edge, point.nodes[0]);
+  const double backward = profile.cost(snap.edge, point.nodes[1]);
+  point.costs_to[0] = backward * snap.fraction;
+  point.costs_to[1] = forward * (1 - snap.fraction);
+  point.costs_from[0] = forward * snap.fraction;
+  point.costs_from[1] = backward * (1 - snap.fraction);
+  point.edge = snap.edge;
+  point.fraction = snap.fraction;
+  point.x = snap.x;
+  point.y = snap.y;
+  point.landmarks = profile.get_landmarks().virtual_row(
+      point.nodes, point.costs_to, point.costs_from, 2);
+  return point;
+}
+
+// Cost of going straight along the edge both points lie on, unvisited when
+// they are not on the same edge
+double along_edge_cost(const RoutingProfile& profile,
+                       const virtual_node_t& from, const virtual_node_t& to) {
+  if (from.edge == no_edge || from.edge != to.edge) {
+    return unvisited;
+  }
+  if (to.fraction >= from.fraction) {
+    return profile.cost(from.edge, from.nodes[0]) *
+           (to.fraction - from.fraction);
   }
-  return false;
+  return profile.cost(from.edge, from.nodes[1]) * (from.fraction - to.fraction);
 }
 
-bool visit_next_node(const Graph& graph, std::stack<const Node*>& stack,
-                     std::unordered_set<const Node*>& visited_from_this_side,
-                     std::unordered_set<const Node*>& visited_from_other_side) {
-  const Node* node = stack.top();
-  stack.pop();
-  if (visited_from_other_side.count(node)) {
-    return true;
-  }
-  if (!visited_from_this_side.count(node)) {
-    visited_from_this_side.insert(node);
-    for (const auto neighbour : graph.get_neighbours(node)) {
-      auto neighbour_node = neighbour.first;
-      stack.push(neighbour_node);
+// The heuristic above from a node to a virtual goal, and from a virtual
+// start to a node
+double heuristic(const Graph& graph, const RoutingProfile& profile,
+                 const node_index_t node, const virtual_node_t& goal) {
+  const double distance = graph.projected_distance(node, goal.x, goal.y) *
+                          profile.min_cost_per_metre();
+  const Landmarks& landmarks = profile.get_landmarks();
+  return std::max(distance, landmarks.lower_bound(landmarks.row(node),
+                                                  goal.landmarks.data()));
+}
+
+double heuristic(const Graph& graph, const RoutingProfile& profile,
+                 const virtual_node_t& start, const node_index_t node) {
+  const double distance = graph.projected_distance(node, start.x, start.y) *
+                          profile.min_cost_per_metre();
+  const Landmarks& landmarks = profile.get_landmarks();
+  return std::max(distance, landmarks.lower_bound(start.landmarks.data(),
+                                                  landmarks.row(node)));
+}
+
+// Weighted A*: with epsilon above 1 the heuristic is inflated, so fewer
+// nodes are expanded. As the heuristic is consistent and closed nodes are
+// never reopened, the route found costs at most epsilon times the optimum.
+// The search leaves the start through its partial edges and reaches the
+// goal, queued as the node after the last one of the graph, through its.
+template <typename OpenSet>
+snapped_path_t a_star_search(const Graph& graph,
+                             const RoutingProfile& profile,
+                             const virtual_node_t& start,
+                             const virtual_node_t& goal,
+                             const double epsilon) {
+  const size_t num_nodes = graph.num_nodes();
+  const node_index_t goal_index = num_nodes;
+  OpenSet open_set(num_nodes + 1);  // Nodes to visit, sorted by lowest f_score
+  std::vector<double> g_score(num_nodes + 1, unvisited);  // Cost from start
+  std::vector<edge_index_t> came_from(num_nodes, no_edge);
+  std::vector<bool> closed(num_nodes, false);
+  node_index_t goal_via = no_node;  // Where the goal was joined from
+  long searched_nodes = 0, relaxed_edges = 0, queue_pushes = 0;
+
+  for (int i = 0; i < 2; i++) {
+    const node_index_t node = start.nodes[i];
+    if (start.costs_to[i] < g_score[node]) {
+      queue_pushes++;
+      g_score[node] = start.costs_to[i];
+      open_set.push(node, g_score[node] +
+                              epsilon * heuristic(graph, profile, node, goal));
     }
   }
-  return false;
-}
+  const double along = along_edge_cost(profile, start, goal);
+  if (along < unvisited) {
+    queue_pushes++;
+    g_score[goal_index] = along;
+    open_set.push(goal_index, along);
+  }
 
-bool find_connected_start_and_goal(const Graph& graph, const Node*& start,
-                                   const Node*& goal) {
-  size_t attempts = 0;
-  double variation = 50;
-  const Node* new_start = nullptr;
-  std::vector<const Node*> attempted_goals = {goal};
-  double goal_error = 0;
-
-  while (new_start == nullptr && attempts < 15) {
-    if (attempts % 5 == 0 && attempts != 0) {
-      variation *= 2;
+  while (!open_set.empty()) {
+    const node_index_t current = open_set.pop();
+    if (current == goal_index) {
+      break;
     }
-    auto start_node = find_nearby_connected_node(start, goal, variation, graph);
-    new_start = start_node.second;
-    if (new_start != nullptr) {
-      start = new_start;
-      const double error = start_node.first + goal_error;
-      // std::cout << "Total distance error: " << error << " after " << attempts
-      // << " attempts" << std::endl;
-      return true;
+    closed[current] = true;
+    searched_nodes++;
+
+    // Join the goal through its partial edges. Once that costs no more than
+    // the key current was popped with, nothing still queued can beat it.
+    bool reached = false;
+    for (int i = 0; i < 2; i++) {
+      if (current != goal.nodes[i]) continue;
+      const double cost = g_score[current] + goal.costs_from[i];
+      if (cost < g_score[goal_index]) {
+        queue_pushes++;
+        g_score[goal_index] = cost;
+        goal_via = current;
+        open_set.push(goal_index, cost);
+        const double h = heuristic(graph, profile, current, goal);
+        reached = reached || cost <= g_score[current] + epsilon * h;
+      }
     }
-    auto goal_node = find_nearby_node(attempted_goals, variation, graph);
-    goal = goal_node.second;
-    if (goal == nullptr) {
-      std::cerr << "Error: No nearby goal node found!" << std::endl;
-      return false;
+    if (reached) {
+      break;
+    }
+
+    for (const auto& pair : graph.get_neighbours(current)) {
+      const node_index_t neighbour = pair.first;
+      const edge_index_t edge = pair.second;
+
+      if (profile.is_blocked(edge) || closed[neighbour]) {
+        continue;  // Skip invalid edges (config constraints)
+      }
+
+      relaxed_edges++;
+      const double tentative_g_score =
+          g_score[current] + profile.cost(edge, current);
+      if (tentative_g_score < g_score[neighbour]) {
+        queue_pushes++;
+        came_from[neighbour] = edge;
+        g_score[neighbour] = tentative_g_score;
+        open_set.push(neighbour,
+                      tentative_g_score +
+                          epsilon * heuristic(graph, profile, neighbour, goal));
+      }
     }
-    goal_error = goal_node.first;
-    attempted_goals.push_back(goal);
-    attempts++;
   }
 
-  std::cerr << "Error: No connection between start and goal found!"
-            << std::endl;
-  return false;
+  record_search(searched_nodes, relaxed_edges, queue_pushes,
+                open_set.stale_pops());
+  snapped_path_t result;
+  if (g_score[goal_index] == unvisited) {
+    std::cerr << "Error: No path found after searching " << searched_nodes
+              << " nodes" << std::endl;
+    return result;
+  }
+  result.found = true;
+  if (goal_via != no_node) {
+    result.path = reconstruct_path(graph, came_from, goal_via);
+    result.first = result.path.empty() ? goal_via : result.path[0].source;
+    result.last = goal_via;
+  }
+  return result;
 }
 
-std::vector<const Node*> a_star(const Graph& graph, const Node*& start,
-                                const Node*& goal) {
-  if (!is_connected(graph, start, goal)) {
-    // std::cout << "Start and goal are not connected" << std::endl;
-    if (!find_connected_start_and_goal(graph, start, goal)) {
-      std::cout << "No connected start and goal found" << std::endl;
-      return {};
+template <typename OpenSet>
+snapped_path_t bidirectional_search(const Graph& graph,
+                                    const RoutingProfile& profile,
+                                    const virtual_node_t& start,
+                                    const virtual_node_t& goal,
+                                    const double epsilon) {
+  // Average potential: the forward search uses p(v) and the reverse search
+  // -p(v), so both see the same (non-negative) reduced edge costs
+  auto potential = [&](const node_index_t node) {
+    return (heuristic(graph, profile, node, goal) -
+            heuristic(graph, profile, start, node)) /
+           2;
+  };
+
+  const size_t num_nodes = graph.num_nodes();
+  // Both directions' costs share one vector. Picking between two vectors by
+  // direction below made GCC 12 falsely warn of freeing a non-heap object.
+  std::vector<double> g_scores(2 * num_nodes, unvisited);
+  double* const g_forward = g_scores.data();
+  double* const g_reverse = g_forward + num_nodes;
+  std::vector<edge_index_t> came_from_forward(num_nodes, no_edge);
+  std::vector<edge_index_t> came_from_reverse(num_nodes, no_edge);
+  std::vector<bool> closed_forward(num_nodes, false);
+  std::vector<bool> closed_reverse(num_nodes, false);
+  OpenSet open_forward(num_nodes), open_reverse(num_nodes);
+
+  // Cost of the best path found so far, with no meeting node while that runs
+  // straight along an edge both lie on
+  double best_cost = along_edge_cost(profile, start, goal);
+  node_index_t meeting_node = no_node;
+  long searched_nodes = 0, relaxed_edges = 0, queue_pushes = 0;
+
+  // Leave the start and reach the goal through their partial edges
+  for (int i = 0; i < 2; i++) {
+    const node_index_t node = start.nodes[i];
+    if (start.costs_to[i] < g_forward[node]) {
+      queue_pushes++;
+      g_forward[node] = start.costs_to[i];
+      open_forward.push(node, g_forward[node] + potential(node));
     }
   }
-  // Priority queue of nodes to visit, sorted by the lowest f_score
-  open_set_t open_set;
-
-  std::unordered_map<const Node*, const Node*>
-      came_from;  // Map of nodes to their parent nodes
-  std::unordered_map<const Node*, double> g_score;  // Cost from start to node
-  std::unordered_map<const Node*, double>
-      f_score;  // Cost from start to goal through node
-  long searched_nodes;
-  init(graph, start, goal, came_from, g_score, f_score, open_set,
-       searched_nodes);
-
-  while (true) {
-    if (open_set.empty()) {
-      std::cerr << "Error: No path found after searching " << searched_nodes
-                << " nodes" << std::endl;
-      return {};
+  for (int i = 0; i < 2; i++) {
+    const node_index_t node = goal.nodes[i];
+    if (goal.costs_from[i] < g_reverse[node]) {
+      queue_pushes++;
+      g_reverse[node] = goal.costs_from[i];
+      open_reverse.push(node, g_reverse[node] - potential(node));
     }
+  }
+  for (const node_index_t node : start.nodes) {
+    if (g_reverse[node] != unvisited &&
+        g_forward[node] + g_reverse[node] < best_cost) {
+      best_cost = g_forward[node] + g_reverse[node];
+      meeting_node = node;
+    }
+  }
 
-    const Node* current =
-        open_set.top()
-            .second;  // Get the node in open_set having the lowest f_score
-    open_set.pop();   // Remove the node from open_set
-    searched_nodes++;
-
-    if (current == goal) {
-      return reconstruct_path(came_from, current);
+  while (!open_forward.empty() && !open_reverse.empty()) {
+    // With potentials summing to zero at the goal, no path found later can
+    // cost less than the two smallest keys together, so stopping once they
+    // reach best_cost / epsilon keeps within epsilon of the optimum
+    const double forward_key = open_forward.top_key();
+    const double reverse_key = open_reverse.top_key();
+    if (epsilon * (forward_key + reverse_key) >= best_cost) {
+      break;
     }
 
-    const auto neighbours = graph.get_neighbours(current);
+    const bool forward = forward_key <= reverse_key;
+    OpenSet& open_set = forward ? open_forward : open_reverse;
+    double* const g = forward ? g_forward : g_reverse;
+    const double* const g_other = forward ? g_reverse : g_forward;
+    std::vector<edge_index_t>& came_from =
+        forward ? came_from_forward : came_from_reverse;
+    std::vector<bool>& closed = forward ? closed_forward : closed_reverse;
+    const double sign = forward ? 1 : -1;
 
-    for (auto& pair : neighbours) {
-      const Node* neighbour = pair.first;
-      const Edge& edge = pair.second;
+    const node_index_t current = open_set.pop();
+    closed[current] = true;
+    searched_nodes++;
+    const double current_g = g[current];
 
-      if (!is_valid_edge(edge)) {
-        continue; // Skip invalid edges (config constraints)
+    for (const auto& pair : graph.get_neighbours(current)) {
+      const node_index_t neighbour = pair.first;
+      const edge_index_t edge = pair.second;
+      if (profile.is_blocked(edge) || closed[neighbour]) {
+        continue;
       }
 
-      const double tentative_g_score = g_score[current] + edge.cost();
-      if (tentative_g_score < g_score[neighbour]) {
-        came_from[neighbour] = current;
-        g_score[neighbour] = tentative_g_score;
-        f_score[neighbour] =
-            g_score[neighbour] +
-            neighbour->distance_to(goal->get_location().first,
-                                   goal->get_location().second);
-        open_set.push(std::make_pair(f_score[neighbour], neighbour));
+      // The reverse search walks edges backwards, towards current
+      relaxed_edges++;
+      const double tentative_g_score =
+          current_g + profile.cost(edge, forward ? current : neighbour);
+      if (tentative_g_score < g[neighbour]) {
+        queue_pushes++;
+        g[neighbour] = tentative_g_score;
+        came_from[neighbour] = edge;
+        open_set.push(neighbour,
+                      tentative_g_score + sign * potential(neighbour));
+      }
+      if (g_other[neighbour] != unvisited &&
+          g[neighbour] + g_other[neighbour] < best_cost) {
+        best_cost = g[neighbour] + g_other[neighbour];
+        meeting_node = neighbour;
       }
     }
   }
+
+  record_search(searched_nodes, relaxed_edges, queue_pushes,
+                open_forward.stale_pops() + open_reverse.stale_pops());
+  snapped_path_t result;
+  if (best_cost == unvisited) {
+    std::cerr << "Error: No path found after searching " << searched_nodes
+              << " nodes" << std::endl;
+    return result;
+  }
+  result.found = true;
+  if (meeting_node == no_node) {
+    return result;
+  }
+
+  // Join the forward half (start -> meeting) with the reverse half
+  path_t& path = result.path;
+  path = reconstruct_path(graph, came_from_forward, meeting_node);
+  for (node_index_t node = meeting_node; came_from_reverse[node] != no_edge;) {
+    const edge_index_t edge = came_from_reverse[node];
+    const node_index_t next = graph.get_edge(edge).opposite(node);
+    path.push_back({edge, node, next});
+    node = next;
+  }
+  result.first = path.empty() ? meeting_node : path.front().source;
+  result.last = path.empty() ? meeting_node : path.back().target;
+  return result;
 }
 
-bool is_valid_edge(const Edge& edge) {
-  if (edge.get_difficulty() > Config::c.max_difficulty) {
-    return false;
+snapped_path_t search_between(const Graph& graph,
+                              const RoutingProfile& profile,
+                              const virtual_node_t& start,
+                              const virtual_node_t& goal,
+                              const Config::search_t& search) {
+  const bool bidirectional =
+      search.mode == Config::SearchMode::Bidirectional;
+  switch (search.queue) {
+    case Config::QueueType::BinaryHeap:
+      return bidirectional ? bidirectional_search<Queue::BinaryHeap>(
+                                 graph, profile, start, goal, search.epsilon)
+                           : a_star_search<Queue::BinaryHeap>(
+                                 graph, profile, start, goal, search.epsilon);
+    case Config::QueueType::RadixHeap:
+      return bidirectional ? bidirectional_search<Queue::RadixHeap>(
+                                 graph, profile, start, goal, search.epsilon)
+                           : a_star_search<Queue::RadixHeap>(
+                                 graph, profile, start, goal, search.epsilon);
+    case Config::QueueType::DaryHeap:
+    default:
+      return bidirectional ? bidirectional_search<Queue::DaryHeap<>>(
+                                 graph, profile, start, goal, search.epsilon)
+                           : a_star_search<Queue::DaryHeap<>>(
+                                 graph, profile, start, goal, search.epsilon);
   }
-  if (edge.get_cars() > Config::c.max_cars) {
-    return false;
+}
+
+// Share of a snapped point's edge between the point and one of its ends
+double partial_length(const Edge& edge, const snap_t& snap,
+                      const node_index_t node) {
+  return (node == edge.get_source() ? snap.fraction : 1 - snap.fraction) *
+         edge.get_length();
+}
+
+}  // namespace
+
+path_t find_path(const Graph& graph, const RoutingProfile& profile,
+                 const Node start, const Node goal,
+                 const Config::search_t& search) {
+  const node_index_t start_index = graph.get_index(start);
+  const node_index_t goal_index = graph.get_index(goal);
+  if (profile.component(start_index) != profile.component(goal_index)) {
+    std::cerr << "Error: No connection between start and goal" << std::endl;
+    return {};
   }
-  return true;
+  return search_between(graph, profile, at_node(graph, profile, start_index),
+                        at_node(graph, profile, goal_index), search)
+      .path;
 }
 
-void print_path(const std::vector<const Node*>& path) {
+snapped_path_t find_path(const Graph& graph, const RoutingProfile& profile,
+                         const snap_t& start, const snap_t& goal,
+                         const Config::search_t& search) {
+  if (!start || !goal) {
+    std::cerr << "Error: Start or goal is not on the graph" << std::endl;
+    return {};
+  }
+  if (profile.component(graph.get_edge(start.edge).get_source()) !=
+      profile.component(graph.get_edge(goal.edge).get_source())) {
+    std::cerr << "Error: No connection between start and goal" << std::endl;
+    return {};
+  }
+  return search_between(graph, profile, at_snap(graph, profile, start),
+                        at_snap(graph, profile, goal), search);
+}
+
+void reverse_path(path_t& path) {
+  std::reverse(path.begin(), path.end());
+  for (DirectedEdge& edge : path) {
+    edge = edge.reversed();
+  }
+}
+
+void print_path(const Graph& graph, const path_t& path) {
   double min_lat = std::numeric_limits<double>::max();
   double max_lat = -std::numeric_limits<double>::max();
   double min_lon = std::numeric_limits<double>::max();
   double max_lon = -std::numeric_limits<double>::max();
-  for (const Node* node : path) {
-    const auto location = node->get_location();
+  if (path.empty()) {
+    return;
+  }
+  std::vector<node_index_t> nodes = {path.front().source};
+  for (const DirectedEdge& edge : path) {
+    nodes.push_back(edge.target);
+  }
+  for (const node_index_t index : nodes) {
+    const Node node = graph.get_node(index);
+    const auto location = node.get_location();
     if (location.first < min_lat) min_lat = location.first;
     if (location.first > max_lat) max_lat = location.first;
     if (location.second < min_lon) min_lon = location.second;
     if (location.second > max_lon) max_lon = location.second;
-    std::cout << "id: " << node->get_id() << ", pos: (" << location.first << ","
-              << location.second << "), elevation: " << node->get_elevation()
+    std::cout << "id: " << node.get_id() << ", pos: (" << location.first << ","
+              << location.second << "), elevation: " << node.get_elevation()
               << std::endl;
   }
   std::cout << "Latitude range: " << min_lat << " - " << max_lat << std::endl;
   std::cout << "Longitude range: " << min_lon << " - " << max_lon << std::endl;
 }
 
-double get_path_length(const std::vector<const Node*>& path) {
+double get_path_length(const Graph& graph, const path_t& path) {
   double length = 0;
-  for (int i = 1; i < path.size(); i++) {
-    const auto location1 = path[i - 1]->get_location();
-    const auto location2 = path[i]->get_location();
-    length += path[i - 1]->distance_to(location2.first, location2.second);
+  for (const DirectedEdge& edge : path) {
+    length += graph.get_edge(edge.edge).get_length();
   }
   return length;
 }
+
+double get_path_length(const Graph& graph, const snapped_path_t& path,
+                       const snap_t& start, const snap_t& goal) {
+  if (!path.found) {
+    return 0;
+  }
+  const Edge& start_edge = graph.get_edge(start.edge);
+  if (path.first == no_node) {
+    return std::abs(goal.fraction - start.fraction) * start_edge.get_length();
+  }
+  return partial_length(start_edge, start, path.first) +
+         get_path_length(graph, path.path) +
+         partial_length(graph.get_edge(goal.edge), goal, path.last);
+}
+
+snapped_path_t join_snaps(const Graph& graph, path_t path,
+                          const snap_t& start, const snap_t& goal) {
+  // Whether the node is an end of the snapped point's edge
+  auto touches = [&](const snap_t& snap, const node_index_t node) {
+    return snap && (graph.get_edge(snap.edge).get_source() == node ||
+                    graph.get_edge(snap.edge).get_target() == node);
+  };
+  snapped_path_t result;
+  if (!path.empty()) {
+    result.found = touches(start, path.front().source) &&
+                   touches(goal, path.back().target);
+    result.first = path.front().source;
+    result.last = path.back().target;
+  } else if (start && goal && start.edge == goal.edge) {
+    result.found = true;
+  } else if (start && goal) {
+    // Through the end the edges share, the nearer one when they share both
+    const Edge& from = graph.get_edge(start.edge);
+    const Edge& to = graph.get_edge(goal.edge);
+    double shortest = std::numeric_limits<double>::max();
+    for (const node_index_t node : {from.get_source(), from.get_target()}) {
+      if (node != to.get_source() && node != to.get_target()) continue;
+      const double length =
+          partial_length(from, start, node) + partial_length(to, goal, node);
+      if (length < shortest) {
+        shortest = length;
+        result.found = true;
+        result.first = result.last = node;
+      }
+    }
+  }
+  result.path = std::move(path);
+  return result;
+}
 }  // namespace Pathfinder
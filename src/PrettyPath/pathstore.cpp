@@ -0,0 +1,67 @@
+#include "pathstore.hh"
+#include <algorithm>
+
+namespace {
+// Position of the edge among the neighbours of the node, 0xf (written out)
+// if it does not reach the node
+size_t neighbour_position(const Graph& graph, const node_index_t node,
+                          const edge_index_t edge) {
+  const auto& neighbours = graph.get_neighbours(node);
+  const auto it =
+      std::find_if(neighbours.begin(), neighbours.end(),
+                   [&](const std::pair<node_index_t, edge_index_t>& next) {
+                     return next.second == edge;
+                   });
+  return it != neighbours.end() ? it - neighbours.begin() : 0xf;
+}
+}  // namespace
+
+PathStore::Path PathStore::get(const Graph& graph, const int i,
+                               const int j) const {
+  const entry_t& entry = m_entries[m_index[key(i, j)]];
+  return Path(graph, m_bytes.data() + entry.offset, entry.size, entry.source);
+}
+
+bool PathStore::contains(const int i, const int j) const {
+  const size_t pair = key(i, j);
+  return pair < m_index.size() && m_index[pair] != no_entry;
+}
+
+void PathStore::add(const Graph& graph, const int i, const int j,
+                    const path_t& path) {
+  const size_t pair = key(i, j);
+  if (pair >= m_index.size()) {
+    m_index.resize(pair + 1, no_entry);
+  }
+  if (m_index[pair] == no_entry) {
+    m_index[pair] = m_entries.size();
+    m_entries.emplace_back();
+  }
+
+  // A replaced path's bytes are left unused
+  entry_t& entry = m_entries[m_index[pair]];
+  entry.offset = m_bytes.size();
+  entry.size = path.size();
+  entry.source = path.empty() ? 0 : path.front().source;
+  for (const DirectedEdge& edge : path) {
+    write_edge(graph, edge);
+  }
+}
+
+size_t PathStore::memory_usage() const {
+  return m_bytes.capacity() + m_entries.capacity() * sizeof(entry_t) +
+         m_index.capacity() * sizeof(uint32_t);
+}
+
+void PathStore::write_edge(const Graph& graph, const DirectedEdge& edge) {
+  const size_t from = neighbour_position(graph, edge.source, edge.edge);
+  const size_t to = neighbour_position(graph, edge.target, edge.edge);
+  if (from < 0xf && to < 0xf) {
+    m_bytes.push_back(from << 4 | to);
+    return;
+  }
+  m_bytes.push_back(escape);
+  for (size_t i = 0; i < sizeof(edge_index_t); i++) {
+    m_bytes.push_back(edge.edge >> (8 * i));
+  }
+}
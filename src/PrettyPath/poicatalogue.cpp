@@ -0,0 +1,99 @@
+#include "poicatalogue.hh"
+#include <numeric>
+
+void POICatalogue::add(const POIData& poi, const POIKind kind) {
+  auto it = m_name_ids.find(poi.name);
+  if (it == m_name_ids.end()) {
+    m_names.push_back(poi.name);
+    it = m_name_ids.emplace(m_names.back(), m_names.size() - 1).first;
+  }
+  m_name.push_back(it->second);
+  m_latitude.push_back(poi.latitude);
+  m_longitude.push_back(poi.longitude);
+  m_elevation.push_back(poi.elevation);
+  m_area.push_back(poi.area);
+  m_kind.push_back(kind);
+  m_osm_id.push_back(poi.osm_id);
+}
+
+void POICatalogue::build() {
+  const size_t n = size();
+  std::vector<PackedRTree<double>::box_t> boxes(n);
+  for (size_t i = 0; i < n; i++) {
+    boxes[i] = {m_longitude[i], m_latitude[i], m_longitude[i], m_latitude[i]};
+  }
+  m_tree.build(boxes);
+  m_bounds = {0, 0, 0, 0};
+  if (n > 0) {
+    m_bounds = boxes[0];
+    for (const auto& box : boxes) {
+      m_bounds.expand(box);
+    }
+  }
+
+  // Stable sorts, so a scan of either order is deterministic
+  m_by_elevation.resize(n);
+  std::iota(m_by_elevation.begin(), m_by_elevation.end(), 0);
+  std::stable_sort(m_by_elevation.begin(), m_by_elevation.end(),
+                   [&](const uint32_t a, const uint32_t b) {
+                     return m_elevation[a] < m_elevation[b];
+                   });
+  m_by_area.resize(n);
+  std::iota(m_by_area.begin(), m_by_area.end(), 0);
+  std::stable_sort(m_by_area.begin(), m_by_area.end(),
+                   [&](const uint32_t a, const uint32_t b) {
+                     return m_area[a] < m_area[b];
+                   });
+  m_sorted_elevation.resize(n);
+  m_sorted_area.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    m_sorted_elevation[i] = m_elevation[m_by_elevation[i]];
+    m_sorted_area[i] = m_area[m_by_area[i]];
+  }
+}
+
+POIData POICatalogue::get(const uint32_t index) const {
+  return POIData(name(index), m_latitude[index], m_longitude[index],
+                 m_osm_id[index], m_elevation[index], m_area[index]);
+}
+
+std::vector<bool> POICatalogue::name_mask(
+    const std::vector<std::string>& names) const {
+  std::vector<bool> mask(m_names.size(), false);
+  for (const std::string& name : names) {
+    const auto it = m_name_ids.find(name);
+    if (it != m_name_ids.end()) {
+      mask[it->second] = true;
+    }
+  }
+  return mask;
+}
+
+std::vector<POIData> POICatalogue::select(const poi_query_t& query) const {
+  std::vector<uint32_t> indices;
+  this->query(query, [&](const uint32_t i) { indices.push_back(i); });
+  std::sort(indices.begin(), indices.end());
+
+  std::vector<POIData> pois;
+  pois.reserve(indices.size());
+  for (const uint32_t i : indices) {
+    pois.push_back(get(i));
+  }
+  return pois;
+}
+
+long POICatalogue::estimate_in_bbox(const poi_query_t& query) const {
+  const double width = m_bounds.max_x - m_bounds.min_x;
+  const double height = m_bounds.max_y - m_bounds.min_y;
+  const double overlap_x =
+      std::min(query.max_longitude, m_bounds.max_x) -
+      std::max(query.min_longitude, m_bounds.min_x);
+  const double overlap_y = std::min(query.max_latitude, m_bounds.max_y) -
+                           std::max(query.min_latitude, m_bounds.min_y);
+  if (overlap_x < 0 || overlap_y < 0) {
+    return 0;
+  }
+  const double fraction_x = width > 0 ? overlap_x / width : 1;
+  const double fraction_y = height > 0 ? overlap_y / height : 1;
+  return static_cast<long>(fraction_x * fraction_y * size());
+}
@@ -2,11 +2,22 @@
 #include <future>
 #include <iomanip>
 #include <mutex>
+#include <random>
 #include "graph.hh"
+#include "lazymatrix.hh"
 #include "parser.hh"
 #include "pathfinder.hh"
 
 namespace TarnRouter {
+// Start temperature of the annealer when refining a previous tour, low
+// enough that it stays close to it
+const double warm_start_temperature = 300;
+// Fewer tarns are searched in full, the rounds of the lazy matrix would take
+// longer than the searches they save
+const int lazy_matrix_min_tarns = 40;
+// Pairs searched up front per tarn, its nearest by straight line
+const size_t lazy_matrix_nearest = 8;
+
 int tsp(int mask, int pos, const std::vector<double>& dist,
         std::vector<double>& dp, std::vector<int>& parent, int n) {
   if (mask == (1 << n) - 1) {
@@ -62,58 +73,95 @@ std::vector<int> route_unordered_tarns_exact(const std::vector<double>& dist,
   return path;
 }
 
+std::vector<POIData> query_tarns(
+    const POICatalogue& catalogue, const double min_elevation,
+    const double max_elevation, const double min_area, const double max_area,
+    const double min_latitude, const double max_latitude,
+    const double min_longitude, const double max_longitude,
+    const std::vector<std::string>& blacklist) {
+  const std::vector<bool> names = catalogue.name_mask(blacklist);
+  poi_query_t query;
+  query.min_latitude = min_latitude;
+  query.max_latitude = max_latitude;
+  query.min_longitude = min_longitude;
+  query.max_longitude = max_longitude;
+  query.min_elevation = min_elevation;
+  query.max_elevation = max_elevation;
+  query.min_area = min_area;
+  query.max_area = max_area;
+  query.kinds = 1 << static_cast<int>(POIKind::Tarn);
+  query.blacklist = &names;
+  return catalogue.select(query);
+}
+
 std::vector<POIData> filter_tarns(
     const std::vector<POIData>& tarns, const double min_elevation,
     const double max_elevation, const double min_area, const double max_area,
     const double min_latitude, const double max_latitude,
     const double min_longitude, const double max_longitude,
     const std::vector<std::string>& blacklist) {
-  std::vector<POIData> filtered_tarns;
   std::cout << "Max Longitude: " << max_longitude << " Min Longitude: "
             << min_longitude << " Max Latitude: " << max_latitude
             << " Min Latitude: " << min_latitude << std::endl;
+  POICatalogue catalogue;
+  for (const POIData& tarn : tarns) {
+    catalogue.add(tarn, POIKind::Tarn);
+  }
+  catalogue.build();
+  return query_tarns(catalogue, min_elevation, max_elevation, min_area,
+                     max_area, min_latitude, max_latitude, min_longitude,
+                     max_longitude, blacklist);
+}
 
-  std::copy_if(
-      tarns.begin(), tarns.end(), std::back_inserter(filtered_tarns),
-      [min_elevation, max_elevation, min_area, max_area, min_latitude,
-       max_latitude, min_longitude, max_longitude,
-       blacklist](const POIData& tarn) {
-        if (tarn.latitude < min_latitude || tarn.latitude > max_latitude ||
-            tarn.longitude < min_longitude || tarn.longitude > max_longitude) {
-          return false;
-        }
-        if (tarn.elevation < min_elevation || tarn.elevation > max_elevation) {
-          return false;
-        }
-        if (tarn.area < min_area || tarn.area > max_area) {
-          return false;
-        }
-        for (const auto& name : blacklist) {
-          if (tarn.name == name) {
-            return false;
-          }
-        }
-        return true;
-      });
+std::vector<POIData> select_tarns(const POICatalogue& catalogue,
+                                  const Config::config_t& config) {
+  return query_tarns(catalogue, config.min_tarn_elevation,
+                     config.max_tarn_elevation, config.min_tarn_area,
+                     config.max_tarn_area, config.min_latitude,
+                     config.max_latitude, config.min_longitude,
+                     config.max_longitude, config.tarn_blacklist);
+}
 
-  return filtered_tarns;
+std::pair<double, path_t> find_path_between_tarns(
+    const Graph& graph, const RoutingProfile& profile, POIData& tarn1,
+    POIData& tarn2, const Config::search_t& search) {
+  if (!tarn1.snap || !tarn2.snap) {
+    Metrics::ScopedTimer timer(Metrics::Phase::Snapping);
+    if (!tarn1.snap) {
+      tarn1.snap = profile.snap(graph, tarn1.latitude, tarn1.longitude);
+    }
+    if (!tarn2.snap) {
+      tarn2.snap = profile.snap(graph, tarn2.latitude, tarn2.longitude);
+    }
+  }
+  auto path =
+      Pathfinder::find_path(graph, profile, tarn1.snap, tarn2.snap, search);
+  if (!path.found) {
+    return std::make_pair(0.0, path_t());
+  }
+  auto length =
+      Pathfinder::get_path_length(graph, path, tarn1.snap, tarn2.snap);
+  return std::make_pair(length, path.path);
 }
 
-std::pair<double, std::vector<const Node*>> find_path_between_tarns(
-    const Graph& graph, POIData& tarn1, POIData& tarn2) {
-  const Node *start, *goal;
-  if (tarn1.best_node != nullptr && tarn2.best_node != nullptr) {
-    start = tarn1.best_node;
-    goal = tarn2.best_node;
-  } else {
-    start = graph.find_closest_node(tarn1.latitude, tarn1.longitude).first;
-    goal = graph.find_closest_node(tarn2.latitude, tarn2.longitude).first;
-  }
-  auto path = Pathfinder::a_star(graph, start, goal);
-  tarn1.best_node = start;
-  tarn2.best_node = goal;
-  auto length = Pathfinder::get_path_length(path);
-  return std::make_pair(length, path);
+double get_route_length(
+    const Graph& graph,
+    const std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>&
+        route) {
+  const auto& pois = route.first;
+  double length = 0;
+  size_t start = 0;
+  for (size_t i = 0; i + 1 < pois.size(); i++) {
+    const auto begin = route.second.begin() + start;
+    start += pois[i].second;
+    const snap_t& from = pois[i].first.snap;
+    const snap_t& to = pois[i + 1].first.snap;
+    const auto leg = Pathfinder::join_snaps(
+        graph, path_t(begin, route.second.begin() + start), from, to);
+    length += leg.found ? Pathfinder::get_path_length(graph, leg, from, to)
+                        : Pathfinder::get_path_length(graph, leg.path);
+  }
+  return length;
 }
 
 double calculate_total_distance(const std::vector<int>& path,
@@ -152,15 +200,46 @@ double calculate_total_distance(const std::vector<int>& path,
   return total_distance / fpath.size();  // Penalize inaccessible tarns FIXME
 }
 
+namespace {
+// How much longer than the straight line the known routes are, on average
+double detour_factor(const LazyMatrix& matrix) {
+  double length = 0, straight = 0;
+  for (size_t i = 0; i < matrix.size(); i++) {
+    for (size_t j = 0; j < matrix.size(); j++) {
+      if (i != j && matrix.known(i, j) &&
+          matrix.lower_bound(i, j) != std::numeric_limits<double>::max()) {
+        length += matrix.lower_bound(i, j);
+        straight += matrix.straight_line(i, j);
+      }
+    }
+  }
+  return straight > 0 && length > straight ? length / straight : 1;
+}
+
+// The same tour walked the other way round, from the same first stop
+std::vector<int> reversed_tour(const std::vector<int>& path) {
+  std::vector<int> reversed(path.rbegin(), path.rend());
+  std::rotate(reversed.begin(), reversed.end() - 1, reversed.end());
+  return reversed;
+}
+}  // namespace
+
 // Use simulated annealing to find a good route
 std::vector<int> route_unordered_tarns(const std::vector<double>& dist,
                                        const int n, const double min_dist,
-                                       const double max_dist) {
+                                       const double max_dist,
+                                       const unsigned int seed,
+                                       const std::vector<int>& initial_path) {
+  Metrics::ScopedTimer timer(Metrics::Phase::Optimization);
   long epoch = 0;
   std::vector<int> current_path(n);
   for (int i = 0; i < n; i++) {
     current_path[i] = i;
   }
+  const bool warm_start = initial_path.size() == static_cast<size_t>(n);
+  if (warm_start) {
+    current_path = initial_path;
+  }
 
   std::vector<int> fpath;
   double current_distance = calculate_total_distance(current_path, dist, n,
@@ -168,19 +247,22 @@ std::vector<int> route_unordered_tarns(const std::vector<double>& dist,
   std::vector<int> best_path = fpath;
   double best_distance = current_distance;
 
-  double temperature = 100000;
+  // A warm start refines the given tour instead of shuffling it away
+  double temperature = warm_start ? warm_start_temperature : 100000;
   double cooling_rate = 0.99995;
 
-  srand(time(0));
+  std::mt19937 rng(seed != 0 ? seed : time(0));
+  std::uniform_int_distribution<int> pick_tarn(1, n - 1);
+  std::uniform_real_distribution<double> accept(0, 1);
 
   while (temperature > 1) {
     std::vector<int> new_path = current_path;
 
     // Swap two random tarns
-    int tarn1 = 1 + rand() % (n - 1);
+    int tarn1 = pick_tarn(rng);
     int tarn2;
     do {
-      tarn2 = 1 + rand() % (n - 1);
+      tarn2 = pick_tarn(rng);
     } while (tarn1 == tarn2);
     std::swap(new_path[tarn1], new_path[tarn2]);
 
@@ -189,7 +271,7 @@ std::vector<int> route_unordered_tarns(const std::vector<double>& dist,
 
     if (new_distance < current_distance ||
         exp((current_distance - new_distance) / temperature) >
-            (rand() % 100) / 100.0) {
+            accept(rng)) {
       current_distance = new_distance;
       current_path = new_path;
       if (current_distance < best_distance) {
@@ -202,26 +284,124 @@ std::vector<int> route_unordered_tarns(const std::vector<double>& dist,
     epoch++;
   }
 
+  // Swaps keep the direction the tour is walked in, which the lengths
+  // depend on
+  const std::vector<int> reversed = reversed_tour(best_path);
+  if (calculate_total_distance(reversed, dist, n, min_dist, max_dist, fpath) <
+      best_distance) {
+    best_path = fpath;
+  }
+
   std::cout << "Epochs: " << epoch << std::endl;
   return best_path;
 }
 
-std::pair<std::vector<double>,
-          std::unordered_map<int, std::vector<const Node*>>>
-find_distances_between_tarns(const Graph& graph, std::vector<POIData>& tarns) {
+std::vector<int> route_unordered_tarns(LazyMatrix& matrix,
+                                       const double min_dist,
+                                       const double max_dist,
+                                       const unsigned int seed,
+                                       const std::vector<int>& initial_path) {
+  const int n = matrix.size();
+  // Tour legs are nearly always between tarns near each other, so each
+  // tarn's nearest by straight line are searched up front
+  std::vector<std::pair<int, int>> nearest;
+  const size_t k = n < lazy_matrix_min_tarns ? n : lazy_matrix_nearest;
+  for (int i = 0; i < n; i++) {
+    std::vector<int> others;
+    for (int j = 0; j < n; j++) {
+      if (j != i) others.push_back(j);
+    }
+    const auto last = others.begin() + std::min(k, others.size());
+    std::partial_sort(others.begin(), last, others.end(),
+                      [&](const int a, const int b) {
+                        return matrix.straight_line(i, a) <
+                               matrix.straight_line(i, b);
+                      });
+    for (auto j = others.begin(); j != last; j++) {
+      nearest.push_back({i, *j});
+      nearest.push_back({*j, i});
+    }
+  }
+  matrix.prefetch(nearest);
+
+  std::vector<int> path = initial_path;
+  std::vector<int> best_path;
+  double best_distance = std::numeric_limits<double>::max();
+  for (int round = 0;; round++) {
+    const double detour = detour_factor(matrix);
+    std::vector<double> dist(n * n);
+    for (int i = 0; i < n * n; i++) {
+      dist[i] = matrix.known(i / n, i % n)
+                    ? matrix.lower_bound(i / n, i % n)
+                    : matrix.straight_line(i / n, i % n) * detour;
+    }
+    path = route_unordered_tarns(dist, n, min_dist, max_dist,
+                                 seed != 0 ? seed + round : 0, path);
+
+    // The tour is searched both ways round, its legs' lengths differ by
+    // direction
+    std::vector<std::pair<int, int>> legs;
+    for (int i = 0; i < n; i++) {
+      legs.push_back({path[i], path[(i + 1) % n]});
+      legs.push_back({path[(i + 1) % n], path[i]});
+    }
+    const size_t searched = matrix.searches();
+    matrix.prefetch(legs);
+    // Scored as the annealer scores it, now that its legs are all known
+    for (const auto& leg : legs) {
+      dist[leg.first * n + leg.second] = matrix.get(leg.first, leg.second);
+    }
+    for (const auto& tour : {path, reversed_tour(path)}) {
+      std::vector<int> fpath;
+      const double distance =
+          calculate_total_distance(tour, dist, n, min_dist, max_dist, fpath);
+      if (distance < best_distance) {
+        best_path = tour;
+        best_distance = distance;
+      }
+    }
+    if (matrix.searches() == searched) {
+      return best_path;
+    }
+  }
+}
+
+std::pair<std::vector<double>, PathStore> find_distances_between_tarns(
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarns, const Config::search_t& search,
+    MatrixCache* cache) {
+  Metrics::ScopedTimer timer(Metrics::Phase::Matrix);
   const size_t n = tarns.size();
   std::vector<double> dist;
   dist.assign(n * n, 0);
-  std::unordered_map<int, std::vector<const Node*>> paths;
+  PathStore paths(n);
+
+  // Pairs found in the cache are not searched again
+  std::vector<bool> cached(n * n, false);
+  size_t reused = 0;
+  for (size_t i = 0; cache != nullptr && i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      double distance;
+      path_t path;
+      if (i != j && cache->find(tarns[i], tarns[j], distance, path)) {
+        dist[i * n + j] = distance;
+        paths.add(graph, i, j, path);
+        cached[i * n + j] = true;
+        reused++;
+      }
+    }
+  }
 
-  const size_t total = n * (n - 1) / 2;
+  const size_t total = n * (n - 1) - reused;
   std::mutex mux;
   size_t done = 0;
 
   // Progress bar lambda
-  auto find_path_between_tarns_wrapper = [&mux, &done, &total, &graph, &tarns](
-                                             size_t i, size_t j) {
-    auto result = find_path_between_tarns(graph, tarns[i], tarns[j]);
+  auto find_path_between_tarns_wrapper = [&mux, &done, &total, &graph,
+                                          &profile, &tarns,
+                                          &search](size_t i, size_t j) {
+    auto result =
+        find_path_between_tarns(graph, profile, tarns[i], tarns[j], search);
     {
       std::lock_guard<std::mutex> lock(mux);
       done++;
@@ -249,48 +429,64 @@ find_distances_between_tarns(const Graph& graph, std::vector<POIData>& tarns) {
     return std::make_tuple(result, i, j);
   };
 
-  std::vector<std::future<
-      std::tuple<std::pair<double, std::vector<const Node*>>, size_t, size_t>>>
+  std::vector<std::future<std::tuple<std::pair<double, path_t>, size_t, size_t>>>
       futures;
 
-  // Compute distances from first tarn to all other tarns, set the best nodes
-  // for each tarn
+  // Wait for the futures to finish and set the distances and paths
+  auto collect = [&]() {
+    for (auto& future : futures) {
+      auto result = future.get();
+      auto path = std::get<0>(result);
+      size_t i = std::get<1>(result);
+      size_t j = std::get<2>(result);
+      dist[i * n + j] = path.first;
+      paths.add(graph, i, j, path.second);
+      if (cache != nullptr &&
+          path.first != std::numeric_limits<double>::max()) {
+        cache->insert(tarns[i], tarns[j], path.first, path.second);
+      }
+    }
+    futures.clear();
+  };
+
+  // Snap every tarn up front, so the searches only read the tarns
+  {
+    Metrics::ScopedTimer timer(Metrics::Phase::Snapping);
+    for (POIData& tarn : tarns) {
+      if (!tarn.snap) {
+        tarn.snap = profile.snap(graph, tarn.latitude, tarn.longitude);
+      }
+    }
+  }
+
+  // Compute distances between the first tarn and all other tarns
   for (size_t j = 1; j < n; j++) {
-    futures.push_back(
-        std::async(std::launch::async, find_path_between_tarns_wrapper, 0, j));
+    if (!cached[j]) {
+      futures.push_back(std::async(std::launch::async,
+                                   find_path_between_tarns_wrapper, 0, j));
+    }
+    if (!cached[j * n]) {
+      futures.push_back(std::async(std::launch::async,
+                                   find_path_between_tarns_wrapper, j, 0));
+    }
   }
-  // Wait for the futures to finish and set the distances and paths
-  for (auto& future : futures) {
-    auto result = future.get();
-    auto path = std::get<0>(result);
-    size_t i = std::get<1>(result);
-    size_t j = std::get<2>(result);
-    dist[i * n + j] = path.first;
-    dist[j * n + i] = path.first;
-    paths[n * i + j] = path.second;
-    paths[n * j + i] = path.second;
-  }
-  futures.clear();
-  // Compute remaning distance pairs
+  collect();
+  // Compute remaning distance pairs, each way as costs differ by direction
   for (size_t i = 1; i < n; i++) {
-    for (size_t j = i + 1; j < n;
-         j++) {  // Only need to calculate distance between each pair once
+    for (size_t j = 1; j < n; j++) {
+      if (i == j || cached[i * n + j]) continue;
       futures.push_back(std::async(std::launch::async,
                                    find_path_between_tarns_wrapper, i, j));
     }
   }
-  for (auto& future : futures) {
-    auto result = future.get();
-    auto path = std::get<0>(result);
-    size_t i = std::get<1>(result);
-    size_t j = std::get<2>(result);
-    dist[i * n + j] = path.first;
-    dist[j * n + i] = path.first;
-    paths[n * i + j] = path.second;
-    paths[n * j + i] = path.second;
-  }
+  collect();
 
   std::cout << std::endl;
+  if (cache != nullptr) {
+    cache->retain(tarns);
+    std::cout << "Reused " << reused << " of " << n * (n - 1)
+              << " tarn pairs from the matrix cache" << std::endl;
+  }
 
   return std::make_pair(dist, paths);
 }
@@ -368,42 +564,152 @@ void renormalise_index_list(std::vector<int>& index_list,
   }
 }
 
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
-reconstruct_path(const std::vector<POIData>& tarns,
-                 std::unordered_map<int, std::vector<const Node*>>& paths,
-                 const int n, const std::vector<int>& index_path) {
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
+reconstruct_path(const Graph& graph, const std::vector<POIData>& tarns,
+                 const PathStore& paths, const std::vector<int>& index_path) {
   std::vector<std::pair<const POIData, size_t>> path;
-  std::vector<const Node*> path_nodes;
+  path_t path_edges;
+
+  // Legs are decoded straight into the route
+  size_t edges = 0;
+  for (size_t i = 0; i < index_path.size(); i++) {
+    edges += paths.get(graph, index_path[i],
+                       index_path[(i + 1) % index_path.size()])
+                 .size();
+  }
+  path_edges.reserve(edges);
 
-  for (int i = 0; i < index_path.size(); i++) {
+  for (size_t i = 0; i < index_path.size(); i++) {
     const int from = index_path[i];
     const int to = index_path[(i + 1) % index_path.size()];
-    path.push_back(std::make_pair(tarns[from], paths.at(n * from + to).size()));
-    if (to < from) {
-      std::reverse(paths[n * from + to].begin(), paths[n * from + to].end());
-    }
-    path_nodes.insert(path_nodes.end(), paths.at(n * from + to).begin(),
-                      paths.at(n * from + to).end());
+    const PathStore::Path leg = paths.get(graph, from, to);
+    path_edges.insert(path_edges.end(), leg.begin(), leg.end());
+    path.push_back(std::make_pair(tarns[from], leg.size()));
   }
   // Add the last tarn
   path.push_back(std::make_pair(tarns[0], 0));
-  return std::make_pair(path, path_nodes);
+  return std::make_pair(path, path_edges);
+}
+
+// The previous tour over the tarns still in reach, as indices into them,
+// with new tarns inserted where their lower bounds lengthen it least. Empty
+// when too little of the previous tour remains to be worth refining.
+std::vector<int> warm_start_path(const std::vector<POIData>& tarns,
+                                 const std::vector<std::string>& tour,
+                                 const LazyMatrix& matrix) {
+  const size_t n = tarns.size();
+  std::unordered_map<std::string, int> reduced_index;
+  for (size_t i = 0; i < n; i++) {
+    reduced_index[MatrixCache::key(tarns[i])] = i;
+  }
+
+  std::vector<int> path;
+  std::vector<bool> in_path(n, false);
+  for (const std::string& key : tour) {
+    const auto it = reduced_index.find(key);
+    if (it != reduced_index.end() && !in_path[it->second]) {
+      path.push_back(it->second);
+      in_path[it->second] = true;
+    }
+  }
+  if (path.size() * 2 < n) {
+    return {};
+  }
+
+  // The annealer keeps the first stop in place
+  if (!in_path[0]) {
+    path.insert(path.begin(), 0);
+    in_path[0] = true;
+  }
+  std::rotate(path.begin(), std::find(path.begin(), path.end(), 0),
+              path.end());
+  for (size_t tarn = 1; tarn < n; tarn++) {
+    if (in_path[tarn]) continue;
+    size_t best_position = path.size();
+    double best_increase = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < path.size(); i++) {
+      const int from = path[i];
+      const int to = path[(i + 1) % path.size()];
+      const double increase = matrix.lower_bound(from, tarn) +
+                              matrix.lower_bound(tarn, to) -
+                              matrix.lower_bound(from, to);
+      if (increase < best_increase) {
+        best_increase = increase;
+        best_position = i + 1;
+      }
+    }
+    path.insert(path.begin() + best_position, tarn);
+  }
+  return path;
+}
+
+Pathfinder::isochrone_t drop_unreachable_tarns(const Graph& graph,
+                                               const RoutingProfile& profile,
+                                               std::vector<POIData>& tarns,
+                                               const double radius) {
+  Metrics::ScopedTimer timer(Metrics::Phase::Matrix);
+  {
+    Metrics::ScopedTimer timer(Metrics::Phase::Snapping);
+    for (POIData& tarn : tarns) {
+      if (!tarn.snap) {
+        tarn.snap = profile.snap(graph, tarn.latitude, tarn.longitude);
+      }
+    }
+  }
+  const auto isochrone =
+      Pathfinder::isochrone(graph, profile, tarns[0].snap, radius);
+  if (!isochrone.source) {
+    return isochrone;
+  }
+
+  const size_t before = tarns.size();
+  tarns.erase(std::remove_if(tarns.begin() + 1, tarns.end(),
+                             [&](const POIData& tarn) {
+                               return isochrone.distance(graph, tarn.snap) >
+                                      radius;
+                             }),
+              tarns.end());
+  std::cout << "Dropped " << before - tarns.size() << " of " << before - 1
+            << " tarns further than " << radius << " m from the start"
+            << std::endl;
+  return isochrone;
 }
 
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
 find_shortest_path_between_tarns(
-    const Graph& graph, std::vector<POIData>& tarns, const double min_dist,
-    const double max_dist, const std::pair<double, double>& start_location) {
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarns, const double min_dist, const double max_dist,
+    const std::pair<double, double>& start_location,
+    const unsigned int seed, const Config::search_t& search,
+    MatrixCache* cache, Pathfinder::isochrone_t* isochrone) {
   if (start_location.first != 0 && start_location.second != 0) {
     tarns.insert(tarns.begin(), POIData("Start", start_location.first,
                                         start_location.second, 0, 0, 0));
+    // A round trip cannot visit a tarn more than half its length away
+    auto reach = drop_unreachable_tarns(graph, profile, tarns, max_dist / 2);
+    if (isochrone != nullptr) {
+      *isochrone = std::move(reach);
+    }
+  }
+  {
+    Metrics::ScopedTimer timer(Metrics::Phase::Snapping);
+    for (POIData& tarn : tarns) {
+      if (!tarn.snap) {
+        tarn.snap = profile.snap(graph, tarn.latitude, tarn.longitude);
+      }
+    }
   }
+
+  // Tarns with too few others near enough to reach, by straight line
   size_t n = tarns.size();
-  auto paths_table = find_distances_between_tarns(graph, tarns);
-  std::vector<double> dist = paths_table.first;
-  auto removed_tarns_index = fliter_tarns_on_max_dist(dist, n, max_dist);
+  std::vector<double> bounds(n * n);
+  {
+    const LazyMatrix all(graph, profile, tarns, search);
+    for (size_t i = 0; i < n * n; i++) {
+      bounds[i] = all.lower_bound(i / n, i % n);
+    }
+  }
+  auto removed_tarns_index = fliter_tarns_on_max_dist(bounds, n, max_dist);
   if (removed_tarns_index.size() > 0) {
     std::cout << "Removed tarns: ";
     for (int index : removed_tarns_index) {
@@ -411,37 +717,83 @@ find_shortest_path_between_tarns(
     }
     std::cout << std::endl;
   }
-  std::unordered_map<int, std::vector<const Node*>> paths = paths_table.second;
+  // The annealer swaps two stops other than the first
+  if (n < 3) {
+    std::cerr << "Error: Too few tarns in reach to route between" << std::endl;
+    return {};
+  }
+  std::vector<POIData> reachable;
+  for (size_t i = 0; i < tarns.size(); i++) {
+    if (std::find(removed_tarns_index.begin(), removed_tarns_index.end(),
+                  static_cast<int>(i)) == removed_tarns_index.end()) {
+      reachable.push_back(tarns[i]);
+    }
+  }
 
-  auto index_path = route_unordered_tarns(dist, n, min_dist, max_dist);
-  // auto tsp_path = route_unordered_tarns_exact(dist, n);
+  // Pairs are only searched once the annealer needs them, or found in the
+  // cache
+  LazyMatrix matrix(graph, profile, reachable, search);
+  size_t reused = 0;
+  for (size_t i = 0; cache != nullptr && i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      double distance;
+      path_t path;
+      if (i != j && cache->find(reachable[i], reachable[j], distance, path)) {
+        matrix.set(i, j, distance, path);
+        reused++;
+      }
+    }
+  }
+
+  std::vector<int> initial_path;
+  if (cache != nullptr) {
+    initial_path = warm_start_path(reachable, cache->get_tour(), matrix);
+  }
+  auto index_path = route_unordered_tarns(matrix, min_dist, max_dist, seed,
+                                          initial_path);
+  std::cout << "Searched " << matrix.searches() << " of "
+            << n * (n - 1) - reused << " tarn pairs" << std::endl;
+  if (cache != nullptr) {
+    std::vector<std::string> tour;
+    for (const int index : index_path) {
+      tour.push_back(MatrixCache::key(reachable[index]));
+    }
+    cache->set_tour(tour);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        if (i != j && matrix.known(i, j) &&
+            matrix.lower_bound(i, j) != std::numeric_limits<double>::max()) {
+          const PathStore::Path path = matrix.paths().get(graph, i, j);
+          cache->insert(reachable[i], reachable[j], matrix.lower_bound(i, j),
+                        path_t(path.begin(), path.end()));
+        }
+      }
+    }
+    cache->retain(tarns);
+    std::cout << "Reused " << reused << " of " << n * (n - 1)
+              << " tarn pairs from the matrix cache" << std::endl;
+  }
+
+  std::cout << "Stored " << matrix.paths().size() << " tarn paths in "
+            << matrix.paths().memory_usage() / 1024 << " KiB" << std::endl;
+  auto path = reconstruct_path(graph, reachable, matrix.paths(), index_path);
   renormalise_index_list(index_path, removed_tarns_index);
-  // renormalise_index_list(tsp_path, removed_tarns_index);
   std::cout << "Index path: ";
   for (int i = 0; i < index_path.size(); i++) {
     std::cout << index_path[i] << " ";
   }
   std::cout << std::endl;
-  // std::cout << "TSP path: ";
-  // for (int i = 0; i < tsp_path.size(); i++) {
-  //   std::cout << tsp_path[i] << " ";
-  // }
-  // std::cout << std::endl;
-
-  auto path = reconstruct_path(tarns, paths, tarns.size(), index_path);
-  // auto path = reconstruct_path(tarns, paths, n, tsp_path);
 
   return path;
 }
 
-std::pair<std::vector<std::pair<const POIData, size_t>>,
-          std::vector<const Node*>>
+std::pair<std::vector<std::pair<const POIData, size_t>>, path_t>
 find_shortest_path_between_ordered_tarns(
-    const Graph& graph, std::vector<POIData>& tarn,
-    const std::pair<double, double>& start_location) {
-  std::pair<std::vector<std::pair<const POIData, size_t>>,
-            std::vector<const Node*>>
-      result;
+    const Graph& graph, const RoutingProfile& profile,
+    std::vector<POIData>& tarn,
+    const std::pair<double, double>& start_location,
+    const Config::search_t& search) {
+  std::pair<std::vector<std::pair<const POIData, size_t>>, path_t> result;
   if (start_location.first != 0 && start_location.second != 0) {
     tarn.insert(tarn.begin(), POIData("Start", start_location.first,
                                       start_location.second, 0, 0, 0));
@@ -451,11 +803,11 @@ find_shortest_path_between_ordered_tarns(
   size_t done = 0;
 
   for (size_t i = 1; i <= tarn.size(); i++) {
-    auto path =
-        find_path_between_tarns(graph, tarn[i - 1], tarn[i % tarn.size()]);
+    auto path = find_path_between_tarns(graph, profile, tarn[i - 1],
+                                        tarn[i % tarn.size()], search);
     if (path.first == 0) {
       std::cerr << "Error: No path found between tarns: " << tarn[i - 1].name
-                << " and " << tarn[i].name << std::endl;
+                << " and " << tarn[i % tarn.size()].name << std::endl;
       continue;
     }
     done++;
@@ -479,7 +831,8 @@ find_shortest_path_between_ordered_tarns(
   }
   std::cout << std::endl;
 
-  result.first.push_back(std::make_pair(tarn.back(), 0));
+  // The route returns to where it started
+  result.first.push_back(std::make_pair(tarn[0], 0));
   return result;
 }
 }  // namespace TarnRouter
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "polyline.hh"
+#include <algorithm>
+#include <cmath>
+
+namespace Polyline {
+
+namespace {
+
+// Distance from p to the segment a-b
+double segment_distance(const std::pair<float, float>& p,
+                        const std::pair<float, float>& a,
+                        const std::pair<float, float>& b) {
+  const double dx = b.first - a.first;
+  const double dy = b.second - a.second;
+  const double length2 = dx * dx + dy * dy;
+  double t = 0;
+  if (length2 > 0) {
+    t = ((p.first - a.first) * dx + (p.second - a.second) * dy) / length2;
+    t = std::max(0.0, std::min(1.0, t));
+  }
+  const double ex = a.first + t * dx - p.first;
+  const double ey = a.second + t * dy - p.second;
+  return std::sqrt(ex * ex + ey * ey);
+}
+
+void encode_value(std::string& buffer, const long value) {
+  unsigned long bits = static_cast<unsigned long>(value) << 1;
+  if (value < 0) bits = ~bits;  // Zig-zag, so small negatives stay short
+  while (bits >= 0x20) {
+    buffer += static_cast<char>((0x20 | (bits & 0x1f)) + 63);
+    bits >>= 5;
+  }
+  buffer += static_cast<char>(bits + 63);
+}
+
+}  // namespace
+
+std::vector<size_t> simplify(const std::vector<std::pair<float, float>>& points,
+                             const double tolerance) {
+  if (points.size() < 3) {
+    std::vector<size_t> indices(points.size());
+    for (size_t i = 0; i < points.size(); i++) indices[i] = i;
+    return indices;
+  }
+
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = keep.back() = true;
+  // Ranges still to split, as (first, last) indices
+  std::vector<std::pair<size_t, size_t>> ranges = {{0, points.size() - 1}};
+  while (!ranges.empty()) {
+    const auto [first, last] = ranges.back();
+    ranges.pop_back();
+    double max_distance = tolerance;
+    size_t furthest = first;
+    for (size_t i = first + 1; i < last; i++) {
+      const double distance =
+          segment_distance(points[i], points[first], points[last]);
+      if (distance > max_distance) {
+        max_distance = distance;
+        furthest = i;
+      }
+    }
+    if (furthest != first) {
+      keep[furthest] = true;
+      ranges.push_back({first, furthest});
+      ranges.push_back({furthest, last});
+    }
+  }
+
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (keep[i]) indices.push_back(i);
+  }
+  return indices;
+}
+
+void encode(std::string& buffer,
+            const std::vector<std::pair<double, double>>& locations) {
+  long previous_lat = 0, previous_lon = 0;
+  for (const auto& location : locations) {
+    const long lat = std::lround(location.first * 1e5);
+    const long lon = std::lround(location.second * 1e5);
+    encode_value(buffer, lat - previous_lat);
+    encode_value(buffer, lon - previous_lon);
+    previous_lat = lat;
+    previous_lon = lon;
+  }
+}
+
+}  // namespace Polyline
@@ -0,0 +1,76 @@
+#include "profile.hh"
+#include <chrono>
+
+RoutingProfile::RoutingProfile(const Graph& graph,
+                               const Config::config_t& config) {
+  const auto start_time = std::chrono::steady_clock::now();
+
+  const size_t num_edges = graph.num_edges();
+  m_costs.resize(2 * num_edges);
+  m_sources.resize(num_edges);
+  size_t blocked_edges = 0;
+  m_min_cost_per_metre = std::numeric_limits<double>::max();
+  for (edge_index_t i = 0; i < num_edges; i++) {
+    const Edge& edge = graph.get_edge(i);
+    m_sources[i] = edge.get_source();
+    if (!edge.is_valid(config)) {
+      m_costs[2 * i] = m_costs[2 * i + 1] = blocked;
+      blocked_edges++;
+      continue;
+    }
+    m_costs[2 * i] = edge.cost(config);
+    m_costs[2 * i + 1] = edge.cost(config, true);
+    if (edge.get_length() > 0) {
+      const double cost = std::min(m_costs[2 * i], m_costs[2 * i + 1]);
+      m_min_cost_per_metre =
+          std::min(m_min_cost_per_metre, cost / edge.get_length());
+    }
+  }
+  if (m_min_cost_per_metre == std::numeric_limits<double>::max()) {
+    m_min_cost_per_metre = 0;
+  }
+
+  // Label the components breadth first, keeping the largest as the main one
+  const size_t num_nodes = graph.num_nodes();
+  const uint32_t unlabelled = std::numeric_limits<uint32_t>::max();
+  m_components.assign(num_nodes, unlabelled);
+  std::vector<node_index_t> queue;
+  uint32_t num_components = 0;
+  for (node_index_t seed = 0; seed < num_nodes; seed++) {
+    if (m_components[seed] != unlabelled) {
+      continue;
+    }
+    const uint32_t component = num_components++;
+    m_components[seed] = component;
+    queue = {seed};
+    for (size_t i = 0; i < queue.size(); i++) {
+      for (const auto& pair : graph.get_neighbours(queue[i])) {
+        if (!is_blocked(pair.second) &&
+            m_components[pair.first] == unlabelled) {
+          m_components[pair.first] = component;
+          queue.push_back(pair.first);
+        }
+      }
+    }
+    if (queue.size() > m_main_component_size) {
+      m_main_component = component;
+      m_main_component_size = queue.size();
+    }
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  std::cout << "Compiled routing profile for " << num_edges << " edges ("
+            << blocked_edges << " blocked, at least " << m_min_cost_per_metre
+            << " per m, " << m_main_component_size << " of " << num_nodes
+            << " nodes connected) in " << elapsed.count() << " us"
+            << std::endl;
+}
+
+snap_t RoutingProfile::snap(const Graph& graph, const double latitude,
+                            const double longitude) const {
+  return graph.snap(latitude, longitude, [&](const edge_index_t edge) {
+    return !is_blocked(edge) &&
+           m_components[m_sources[edge]] == m_main_component;
+  });
+}
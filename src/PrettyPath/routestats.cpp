@@ -0,0 +1,87 @@
+#include "routestats.hh"
+#include <algorithm>
+#include <cmath>
+
+namespace RouteStats {
+
+namespace {
+
+// Tobler's hiking function, in m/s: 6 km/h at its fastest, on a slight
+// downhill grade (rise over run)
+double walking_speed(const double grade) {
+  return 6 / 3.6 * std::exp(-3.5 * std::abs(grade + 0.05));
+}
+
+}  // namespace
+
+void stats_t::add(const stats_t& other) {
+  length += other.length;
+  ascent += other.ascent;
+  descent += other.descent;
+  ascent_length += other.ascent_length;
+  descent_length += other.descent_length;
+  flat_length += other.flat_length;
+  time += other.time;
+  grade_lengths.resize(std::max(grade_lengths.size(),
+                                other.grade_lengths.size()),
+                       0);
+  for (size_t i = 0; i < other.grade_lengths.size(); i++) {
+    grade_lengths[i] += other.grade_lengths[i];
+  }
+}
+
+Accumulator::Accumulator(const Config::route_stats_t& options)
+    : m_options(options) {
+  m_stats.grade_lengths.assign(options.grade_bins.size() + 1, 0);
+}
+
+void Accumulator::add(const double length, const double elevation) {
+  if (!m_started) {
+    m_started = true;
+    m_elevation = m_reference = elevation;
+    return;
+  }
+
+  const double change = elevation - m_elevation;
+  m_elevation = elevation;
+  m_stats.length += length;
+  if (change > 0) {
+    m_stats.ascent_length += length;
+  } else if (change < 0) {
+    m_stats.descent_length += length;
+  } else {
+    m_stats.flat_length += length;
+  }
+
+  // Hysteresis: the reference only moves once the elevation leaves the
+  // threshold around it
+  if (elevation - m_reference > m_options.ascent_threshold) {
+    m_stats.ascent += elevation - m_reference;
+    m_reference = elevation;
+  } else if (m_reference - elevation > m_options.ascent_threshold) {
+    m_stats.descent += m_reference - elevation;
+    m_reference = elevation;
+  }
+
+  if (length <= 0) {
+    return;
+  }
+  const double grade = change / length;
+  const auto& bins = m_options.grade_bins;
+  const size_t bin =
+      std::upper_bound(bins.begin(), bins.end(), 100 * grade) - bins.begin();
+  m_stats.grade_lengths[bin] += length;
+  m_stats.time += length / walking_speed(grade);
+}
+
+stats_t Accumulator::finish() {
+  if (m_elevation > m_reference) {
+    m_stats.ascent += m_elevation - m_reference;
+  } else {
+    m_stats.descent += m_reference - m_elevation;
+  }
+  m_reference = m_elevation;
+  return m_stats;
+}
+
+}  // namespace RouteStats
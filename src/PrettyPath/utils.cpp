@@ -0,0 +1,21 @@
+#include "utils.hh"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DISPATCH_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define DISPATCH_TARGETS
+#endif
+
+namespace utils {
+
+DISPATCH_TARGETS
+void distances_to(const float x, const float y, const float* xs,
+                  const float* ys, const size_t n, float* distances) {
+  for (size_t i = 0; i < n; i++) {
+    const float dx = xs[i] - x;
+    const float dy = ys[i] - y;
+    distances[i] = sqrtf(dx * dx + dy * dy);
+  }
+}
+
+}  // namespace utils
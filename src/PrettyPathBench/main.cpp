@@ -0,0 +1,260 @@
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <thread>
+#include "config.hh"
+#include "graph.hh"
+#include "metrics.hh"
+#include "parser.hh"
+#include "pathfinder.hh"
+#include "poirouter.hh"
+#include "profile.hh"
+
+// Times the routing pipeline stage by stage over a fixed corpus of queries
+// and search engines, and writes the results as JSON so runs on different
+// engines or commits can be compared on the same workload.
+
+Config::config_t Config::c;
+
+namespace {
+
+struct query_t {
+  std::string from, to;
+  std::pair<double, double> start, goal;
+};
+
+struct engine_t {
+  std::string name;
+  Config::search_t search;
+};
+
+// Times of each repetition in ms, items is how many operations one
+// repetition covers (e.g. the number of queries)
+nlohmann::json run_benchmark(const std::string& name, const size_t repetitions,
+                             const size_t items,
+                             const std::function<void()>& body) {
+  Metrics::reset();
+  std::vector<double> times;
+  for (size_t i = 0; i < repetitions; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    times.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  }
+  std::sort(times.begin(), times.end());
+  const double median = times[times.size() / 2];
+
+  nlohmann::json result = {{"name", name},
+                           {"repetitions", repetitions},
+                           {"items", items},
+                           {"time_unit", "ms"},
+                           {"real_time", median},
+                           {"min_time", times.front()},
+                           {"max_time", times.back()},
+                           {"item_time", median / std::max<size_t>(items, 1)}};
+  const uint64_t queries = Metrics::total(Metrics::Counter::Queries);
+  if (queries > 0) {
+    result["counters"] = {
+        {"queries", queries / repetitions},
+        {"nodes_expanded",
+         Metrics::total(Metrics::Counter::NodesExpanded) / queries},
+        {"edges_relaxed",
+         Metrics::total(Metrics::Counter::EdgesRelaxed) / queries},
+        {"queue_pushes",
+         Metrics::total(Metrics::Counter::QueuePushes) / queries},
+        {"stale_pops", Metrics::total(Metrics::Counter::StalePops) / queries}};
+  }
+  printf("%-44s %10.3f ms %10.3f ms/item %6zu items\n", name.c_str(), median,
+         median / std::max<size_t>(items, 1), items);
+  fflush(stdout);
+  return result;
+}
+
+void handle_option(int argc, char** argv, std::string& corpus_filename,
+                   std::string& config_filename, std::string& out_filename,
+                   size_t& repetitions) {
+  const option long_options[] = {
+      {"corpus", required_argument, nullptr, 'q'},
+      {"config", required_argument, nullptr, 'c'},
+      {"out", required_argument, nullptr, 'o'},
+      {"repetitions", required_argument, nullptr, 'r'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "q:c:o:r:", long_options,
+                            nullptr)) != -1) {
+    switch (opt) {
+      case 'q':
+        corpus_filename = optarg;
+        break;
+      case 'c':
+        config_filename = optarg;
+        break;
+      case 'o':
+        out_filename = optarg;
+        break;
+      case 'r': {
+        // Each benchmark reports the median and fastest repetition
+        const long value = std::atol(optarg);
+        if (value < 1) {
+          std::cerr << "Repetitions must be at least 1" << std::endl;
+          exit(1);
+        }
+        repetitions = value;
+        break;
+      }
+      default:
+        std::cerr << "Usage: " << argv[0]
+                  << " [--corpus bench/corpus.json] [--config <config_file>]"
+                     " [--out <results.json>] [--repetitions <n>]"
+                  << std::endl;
+        exit(1);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string corpus_filename = "bench/corpus.json";
+  std::string config_filename;  // Defaults to the corpus's config
+  std::string out_filename = "bench_results.json";
+  size_t repetitions = 0;  // Defaults to the corpus's repetitions
+  handle_option(argc, argv, corpus_filename, config_filename, out_filename,
+                repetitions);
+
+  std::ifstream corpus_file(corpus_filename);
+  if (!corpus_file.is_open()) {
+    std::cerr << "Could not open corpus file " << corpus_filename
+              << std::endl;
+    return 1;
+  }
+  nlohmann::json corpus;
+  corpus_file >> corpus;
+  if (config_filename.empty()) config_filename = corpus["config"];
+  if (repetitions == 0) repetitions = corpus.value("repetitions", 5);
+  if (repetitions == 0) {
+    std::cerr << "Repetitions must be at least 1" << std::endl;
+    return 1;
+  }
+
+  std::vector<query_t> queries;
+  for (const auto& query : corpus["queries"]) {
+    queries.push_back({query["from"], query["to"],
+                       {query["start"][0], query["start"][1]},
+                       {query["goal"][0], query["goal"][1]}});
+  }
+  std::vector<engine_t> engines;
+  for (const auto& engine : corpus["engines"]) {
+    engine_t entry{engine["name"], Config::search_t()};
+    if (engine.find("search") != engine.end())
+      Config::get_search_config(engine["search"], entry.search);
+    engines.push_back(entry);
+  }
+
+  Config::get_config(config_filename);
+  if (!Config::check_config()) {
+    return 1;
+  }
+
+  nlohmann::json benchmarks = nlohmann::json::array();
+  Parser parser(Config::c.nodes_filename, Config::c.edges_filename);
+
+  benchmarks.push_back(run_benchmark("load", repetitions, 1, [&]() {
+    Graph graph;
+    MapData map = parser.read_map_data(graph);
+    RoutingProfile profile(graph, Config::c);
+    profile.build_landmarks(graph, Config::c.search.landmarks);
+  }));
+
+  Graph graph;
+  MapData map = parser.read_map_data(graph);
+  RoutingProfile profile(graph, Config::c);
+
+  std::vector<std::pair<snap_t, snap_t>> snapped(queries.size());
+  benchmarks.push_back(
+      run_benchmark("snap", repetitions, 2 * queries.size(), [&]() {
+        for (size_t i = 0; i < queries.size(); i++) {
+          snapped[i].first = profile.snap(graph, queries[i].start.first,
+                                          queries[i].start.second);
+          snapped[i].second = profile.snap(graph, queries[i].goal.first,
+                                           queries[i].goal.second);
+        }
+      }));
+
+  POICatalogue catalogue;
+  parser.read_poi_catalogue(Config::c.tarns_filename, POIKind::Tarn,
+                            catalogue);
+  catalogue.build();
+  const auto tarns = TarnRouter::select_tarns(catalogue);
+  const size_t n = tarns.size();
+
+  std::vector<double> dist;
+  for (const engine_t& engine : engines) {
+    Config::c.search = engine.search;
+    profile.build_landmarks(graph, engine.search.landmarks);
+
+    benchmarks.push_back(run_benchmark(
+        "find_path/" + engine.name, repetitions, queries.size(), [&]() {
+          for (const auto& pair : snapped) {
+            Pathfinder::find_path(graph, profile, pair.first, pair.second,
+                                  engine.search);
+          }
+        }));
+
+    if (n < 2) continue;
+    benchmarks.push_back(run_benchmark(
+        "find_distances_between_tarns/" + engine.name, repetitions,
+        n * (n - 1) / 2, [&]() {
+          std::vector<POIData> copy = tarns;  // Snapping is cached per tarn
+          dist = TarnRouter::find_distances_between_tarns(graph, profile, copy)
+                     .first;
+        }));
+  }
+
+  if (n >= 2) {
+    benchmarks.push_back(
+        run_benchmark("route_unordered_tarns", repetitions, n, [&]() {
+          TarnRouter::route_unordered_tarns(dist, n, Config::c.min_path_length,
+                                            Config::c.max_path_length,
+                                            Config::c.seed);
+        }));
+
+    std::vector<POIData> copy = tarns;
+    const auto path = TarnRouter::find_shortest_path_between_tarns(
+        graph, profile, copy, Config::c.min_path_length,
+        Config::c.max_path_length, Config::c.start_location,
+        Config::c.seed);
+    const std::string dir =
+        (std::filesystem::temp_directory_path() / "PrettyPathBench/")
+            .string();
+    benchmarks.push_back(run_benchmark(
+        "write_paths", repetitions, path.second.size(), [&]() {
+          parser.write_paths(map, graph, path, dir, Config::c.gpx_filename,
+                             Config::c.route_filename, Config::c.route_output);
+        }));
+    std::filesystem::remove_all(dir);
+  }
+
+  nlohmann::json results = {
+      {"context",
+       {{"corpus", corpus_filename},
+        {"config", config_filename},
+        {"nodes", graph.num_nodes()},
+        {"edges", graph.num_edges()},
+        {"tarns", n},
+        {"queries", queries.size()},
+        {"num_cpus", std::thread::hardware_concurrency()}}},
+      {"benchmarks", benchmarks}};
+  std::ofstream out(out_filename);
+  if (!out.is_open()) {
+    std::cerr << "Could not open output file " << out_filename << std::endl;
+    return 1;
+  }
+  out << results.dump(2) << std::endl;
+  std::cout << "Wrote results to " << out_filename << std::endl;
+}
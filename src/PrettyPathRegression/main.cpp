@@ -0,0 +1,258 @@
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <nlohmann/json.hpp>
+#include "config.hh"
+#include "graph.hh"
+#include "metrics.hh"
+#include "parser.hh"
+#include "pathfinder.hh"
+#include "poirouter.hh"
+#include "profile.hh"
+
+// Runs the fixed cases of a regression file (a config, optionally with
+// search overrides, against a small checked-in dataset) and compares route
+// cost and length with golden values, and nodes expanded with recorded
+// baselines. Wall time depends on the machine, so it is only reported against
+// its baseline unless --check-time is given. --update records the current
+// results as the goldens.
+
+Config::config_t Config::c;
+
+namespace {
+
+struct result_t {
+  double cost = 0;
+  double length = 0;
+  double time = 0;  // ms, fastest of the repetitions
+  uint64_t nodes_expanded = 0;
+  std::vector<std::string> order;
+};
+
+// Tolerances are fractions of the golden value. Cost and length may differ
+// either way, time and nodes expanded only fail when they grow.
+struct tolerance_t {
+  double cost = 1e-4;
+  double length = 1e-3;
+  double time = 0.5;
+  double nodes_expanded = 0.1;
+  double min_time = 1;  // ms, shorter baselines are timer noise
+};
+
+void get_tolerances(const nlohmann::json& json, tolerance_t& tolerance) {
+  tolerance.cost = json.value("cost", tolerance.cost);
+  tolerance.length = json.value("length", tolerance.length);
+  tolerance.time = json.value("time", tolerance.time);
+  tolerance.nodes_expanded =
+      json.value("nodes_expanded", tolerance.nodes_expanded);
+  tolerance.min_time = json.value("min_time_ms", tolerance.min_time);
+}
+
+result_t run_case(const nlohmann::json& test, const size_t repetitions) {
+  Config::c = Config::config_t();
+  Config::get_config(test["config"]);
+  if (test.find("search") != test.end())
+    Config::get_search_config(test["search"], Config::c.search);
+  if (!Config::check_config()) {
+    exit(1);
+  }
+
+  Parser parser(Config::c.nodes_filename, Config::c.edges_filename);
+  Graph graph;
+  MapData map = parser.read_map_data(graph);
+  RoutingProfile profile(graph, Config::c);
+  profile.build_landmarks(graph, Config::c.search.landmarks);
+
+  std::vector<POIData> tarns;
+  if (Config::c.use_ordered_tarns) {
+    tarns = parser.read_ordered_poi_data(Config::c.tarns_filename);
+  } else {
+    POICatalogue catalogue;
+    parser.read_poi_catalogue(Config::c.tarns_filename, POIKind::Tarn,
+                              catalogue);
+    catalogue.build();
+    tarns = TarnRouter::select_tarns(catalogue);
+  }
+
+  // Everything after loading is timed: snapping, the distance matrix, the
+  // tour and path reconstruction
+  std::pair<std::vector<std::pair<const POIData, size_t>>, path_t> path;
+  std::vector<double> times;
+  Metrics::reset();
+  for (size_t i = 0; i < repetitions; i++) {
+    std::vector<POIData> copy = tarns;  // Snapping is cached per tarn
+    const auto start = std::chrono::steady_clock::now();
+    if (Config::c.use_ordered_tarns) {
+      path = TarnRouter::find_shortest_path_between_ordered_tarns(
+          graph, profile, copy, Config::c.start_location);
+    } else {
+      path = TarnRouter::find_shortest_path_between_tarns(
+          graph, profile, copy, Config::c.min_path_length,
+          Config::c.max_path_length, Config::c.start_location,
+          Config::c.seed);
+    }
+    times.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  }
+
+  result_t result;
+  for (const DirectedEdge& edge : path.second) {
+    result.cost += profile.cost(edge.edge, edge.source);
+  }
+  result.length = TarnRouter::get_route_length(graph, path);
+  // The fastest run is the least disturbed by the rest of the machine
+  result.time = *std::min_element(times.begin(), times.end());
+  result.nodes_expanded =
+      Metrics::total(Metrics::Counter::NodesExpanded) / repetitions;
+  for (const auto& tarn : path.first) {
+    result.order.push_back(tarn.first.name);
+  }
+  parser.clean_map_data(map);
+  return result;
+}
+
+// Equivalent routes may differ slightly either way
+bool check_equal(const std::string& name, const double value,
+                 const double golden, const double tolerance) {
+  const bool ok = std::abs(value - golden) <= tolerance * std::abs(golden);
+  printf("  %-15s %14.3f  golden %14.3f  %s\n", name.c_str(), value, golden,
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Only growth beyond the tolerance is a regression. An advisory check is
+// reported but never fails.
+bool check_bound(const std::string& name, const double value,
+                 const double baseline, const double tolerance,
+                 const bool advisory = false) {
+  const bool ok = value <= baseline * (1 + tolerance);
+  printf("  %-15s %14.3f  golden %14.3f  %+6.1f %%  %s\n", name.c_str(), value,
+         baseline, baseline > 0 ? 100 * (value / baseline - 1) : 0.0,
+         ok ? "ok" : advisory ? "slower (advisory)" : "FAILED");
+  return ok || advisory;
+}
+
+bool check_case(const nlohmann::json& golden, const result_t& result,
+                const tolerance_t& tolerance, const bool check_time) {
+  bool ok = true;
+  ok &= check_equal("cost", result.cost, golden["cost"], tolerance.cost);
+  ok &= check_equal("length", result.length, golden["length"],
+                    tolerance.length);
+  const double time = golden["time_ms"];
+  ok &= check_bound("time_ms", result.time, std::max(time, tolerance.min_time),
+                    tolerance.time, !check_time);
+  ok &= check_bound("nodes_expanded", result.nodes_expanded,
+                    golden["nodes_expanded"], tolerance.nodes_expanded);
+  // The tour may legitimately change between equivalent routes, so the
+  // order is reported but not checked
+  std::cout << "  order          ";
+  for (const auto& name : result.order) {
+    std::cout << " " << name;
+  }
+  std::cout << std::endl;
+  return ok;
+}
+
+void handle_option(int argc, char** argv, std::string& cases_filename,
+                   std::string& case_name, bool& update, bool& check_time) {
+  const option long_options[] = {
+      {"cases", required_argument, nullptr, 'f'},
+      {"case", required_argument, nullptr, 'n'},
+      {"update", no_argument, nullptr, 'u'},
+      {"check-time", no_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "f:n:ut", long_options, nullptr)) !=
+         -1) {
+    switch (opt) {
+      case 'f':
+        cases_filename = optarg;
+        break;
+      case 'n':
+        case_name = optarg;
+        break;
+      case 'u':
+        update = true;
+        break;
+      case 't':
+        check_time = true;
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0]
+                  << " [--cases cases.json] [--case <name>] [--update]"
+                     " [--check-time]"
+                  << std::endl;
+        exit(1);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string cases_filename = "cases.json";
+  std::string case_name;  // Empty runs every case
+  bool update = false;
+  bool check_time = false;  // Fail on wall time, on the baselines' machine
+  handle_option(argc, argv, cases_filename, case_name, update, check_time);
+
+  std::ifstream cases_file(cases_filename);
+  if (!cases_file.is_open()) {
+    std::cerr << "Could not open cases file " << cases_filename << std::endl;
+    return 1;
+  }
+  nlohmann::json cases;
+  cases_file >> cases;
+  cases_file.close();
+
+  const size_t repetitions = cases.value("repetitions", 5);
+  tolerance_t tolerance;
+  if (cases.find("tolerances") != cases.end())
+    get_tolerances(cases["tolerances"], tolerance);
+
+  bool ok = true, found = false;
+  for (auto& test : cases["cases"]) {
+    const std::string name = test["name"];
+    if (!case_name.empty() && name != case_name) continue;
+    found = true;
+
+    const result_t result = run_case(test, repetitions);
+    std::cout << std::endl << name << ":" << std::endl;
+    if (update) {
+      test["golden"] = {{"cost", result.cost},
+                        {"length", result.length},
+                        {"time_ms", result.time},
+                        {"nodes_expanded", result.nodes_expanded},
+                        {"order", result.order}};
+      std::cout << "  updated" << std::endl;
+      continue;
+    }
+    if (test.find("golden") == test.end()) {
+      std::cerr << "No golden values for " << name << ", run with --update"
+                << std::endl;
+      ok = false;
+      continue;
+    }
+    tolerance_t case_tolerance = tolerance;
+    if (test.find("tolerances") != test.end())
+      get_tolerances(test["tolerances"], case_tolerance);
+    ok &= check_case(test["golden"], result, case_tolerance, check_time);
+  }
+
+  if (!found) {
+    std::cerr << "No case named " << case_name << std::endl;
+    return 1;
+  }
+  if (update) {
+    std::ofstream out(cases_filename);
+    if (!out.is_open()) {
+      std::cerr << "Could not open cases file " << cases_filename << std::endl;
+      return 1;
+    }
+    out << cases.dump(2) << std::endl;
+    std::cout << "Wrote golden values to " << cases_filename << std::endl;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,502 @@
+#include "generator.hh"
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr size_t buffer_size = 1024 * 1024;
+constexpr unsigned int max_water_size = 16;  // Vertices per water polygon
+
+// Keys of the different random streams
+enum Stream : uint64_t {
+  JitterLat = 1,
+  JitterLon,
+  Segment,
+  Wiggle,
+  Split,
+  Highway,
+  Foot,
+  Sac,
+  Water,
+  Peak,
+  Noise = 100
+};
+
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+double smoothstep(const double t) { return t * t * (3 - 2 * t); }
+
+}  // namespace
+
+namespace synthmap {
+
+double hash_unit(const uint64_t seed, const uint64_t a, const uint64_t b,
+                 const uint64_t c) {
+  const uint64_t h =
+      splitmix64(splitmix64(splitmix64(splitmix64(seed) ^ a) ^ b) ^ c);
+  return (h >> 11) * (1.0 / 9007199254740992.0);  // 53 bits
+}
+
+Terrain::Terrain(const Bounds& bounds, const uint64_t seed)
+    : m_bounds(bounds), m_seed(seed) {
+  const double lat_center = (bounds.min_lat + bounds.max_lat) / 2;
+  m_lat_to_m = 111320.0;
+  m_lon_to_m = 111320.0 * cos(lat_center * M_PI / 180.0);
+}
+
+// Value noise on the integer lattice, smoothly interpolated
+double Terrain::noise(const double x, const double y,
+                      const uint64_t octave) const {
+  const double fx = std::floor(x), fy = std::floor(y);
+  const uint64_t xi = static_cast<int64_t>(fx), yi = static_cast<int64_t>(fy);
+  const double tx = smoothstep(x - fx), ty = smoothstep(y - fy);
+  const uint64_t stream = Stream::Noise + octave;
+  const double v00 = hash_unit(m_seed, stream, xi, yi);
+  const double v10 = hash_unit(m_seed, stream, xi + 1, yi);
+  const double v01 = hash_unit(m_seed, stream, xi, yi + 1);
+  const double v11 = hash_unit(m_seed, stream, xi + 1, yi + 1);
+  const double top = v00 + (v10 - v00) * tx;
+  const double bottom = v01 + (v11 - v01) * tx;
+  return top + (bottom - top) * ty;
+}
+
+float Terrain::elevation(const double lat, const double lon) const {
+  const double x = (lon - m_bounds.min_lon) * m_lon_to_m;
+  const double y = (lat - m_bounds.min_lat) * m_lat_to_m;
+  // Octaves from 8 km fells down to 60 m hummocks
+  double sum = 0, weight = 0, amplitude = 1, frequency = 1 / 8000.0;
+  for (uint64_t octave = 0; octave < 8; octave++) {
+    sum += amplitude * noise(x * frequency, y * frequency, octave);
+    weight += amplitude;
+    amplitude *= 0.5;
+    frequency *= 2;
+  }
+  // Sums cluster around 0.5, stretch 0.25 - 0.7 to valley floors and fell
+  // tops with broad lowlands and steepening summits
+  const double f = std::clamp((sum / weight - 0.25) / 0.45, 0.0, 1.0);
+  return 40 + 900 * std::pow(f, 1.5);
+}
+
+bool Terrain::write_geotiff(const std::string& filename,
+                            const double resolution) const {
+  GDALAllRegister();
+  GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+  if (driver == nullptr) {
+    std::cerr << "GTiff driver not available" << std::endl;
+    return false;
+  }
+
+  // Pad by two pixels so every generated node samples inside the raster
+  const double pixel_lat = resolution / m_lat_to_m;
+  const double pixel_lon = resolution / m_lon_to_m;
+  const double min_lon = m_bounds.min_lon - 2 * pixel_lon;
+  const double max_lat = m_bounds.max_lat + 2 * pixel_lat;
+  const int width = std::ceil((m_bounds.max_lon - m_bounds.min_lon) /
+                              pixel_lon) + 4;
+  const int height = std::ceil((m_bounds.max_lat - m_bounds.min_lat) /
+                               pixel_lat) + 4;
+
+  char** options = nullptr;
+  options = CSLSetNameValue(options, "COMPRESS", "DEFLATE");
+  options = CSLSetNameValue(options, "TILED", "YES");
+  options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+  GDALDataset* dataset = driver->Create(filename.c_str(), width, height, 1,
+                                        GDT_Float32, options);
+  CSLDestroy(options);
+  if (dataset == nullptr) {
+    std::cerr << "Failed to create " << filename << std::endl;
+    return false;
+  }
+
+  double transform[6] = {min_lon, pixel_lon, 0, max_lat, 0, -pixel_lat};
+  dataset->SetGeoTransform(transform);
+  OGRSpatialReference srs;
+  srs.SetWellKnownGeogCS("WGS84");
+  char* wkt = nullptr;
+  srs.exportToWkt(&wkt);
+  dataset->SetProjection(wkt);
+  CPLFree(wkt);
+
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+  std::vector<float> row(width);
+  bool ok = true;
+  for (int y = 0; y < height && ok; y++) {
+    const double lat = max_lat - (y + 0.5) * pixel_lat;
+    for (int x = 0; x < width; x++) {
+      row[x] = elevation(lat, min_lon + (x + 0.5) * pixel_lon);
+    }
+    ok = band->RasterIO(GF_Write, 0, y, width, 1, row.data(), width, 1,
+                        GDT_Float32, 0, 0) == CE_None;
+  }
+  if (!ok) {
+    std::cerr << "RasterIO failed: " << CPLGetLastErrorMsg() << std::endl;
+  }
+  GDALClose(dataset);
+  std::cout << "Wrote " << width << "x" << height << " DEM at " << resolution
+            << " m to " << filename << std::endl;
+  return ok;
+}
+
+NetworkWriter::NetworkWriter(const Options& options, const Terrain& terrain)
+    : m_options(options),
+      m_terrain(terrain),
+      m_buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes) {
+  const Bounds& b = options.bounds;
+  // Each junction brings itself plus the shape nodes of its east and south
+  // segments, which exist with probability 0.85 and 0.7
+  const double nodes_per_junction = 1 + options.shape_nodes * (0.85 + 0.7);
+  const double junctions = std::max(4.0, options.nodes / nodes_per_junction);
+  const double width = (b.max_lon - b.min_lon) * terrain.lon_to_m();
+  const double height = (b.max_lat - b.min_lat) * terrain.lat_to_m();
+  const double spacing = std::sqrt(width * height / junctions);
+  m_cols = std::max<uint64_t>(2, std::llround(width / spacing));
+  m_rows = std::max<uint64_t>(2, std::llround(height / spacing));
+  m_col_step = (b.max_lon - b.min_lon) / m_cols;
+  m_row_step = (b.max_lat - b.min_lat) / m_rows;
+
+  if (m_options.tarns == 0) {
+    m_options.tarns = std::max<uint64_t>(10, options.nodes / 10000);
+  }
+  if (m_options.peaks == 0) {
+    m_options.peaks = std::max<uint64_t>(10, options.nodes / 20000);
+  }
+
+  const uint64_t lattice = m_rows * m_cols;
+  m_shape_base[true] = 1 + lattice;
+  m_shape_base[false] = m_shape_base[true] + lattice * options.shape_nodes;
+  m_water_base = m_shape_base[false] + lattice * options.shape_nodes;
+  m_peak_base = m_water_base + m_options.tarns * max_water_size;
+}
+
+NetworkWriter::location_t NetworkWriter::junction(const uint64_t row,
+                                                  const uint64_t col) const {
+  const uint64_t seed = m_options.seed;
+  const double jitter_lat = hash_unit(seed, JitterLat, row, col) - 0.5;
+  const double jitter_lon = hash_unit(seed, JitterLon, row, col) - 0.5;
+  return {m_options.bounds.max_lat - (row + 0.5 + 0.6 * jitter_lat) *
+                                         m_row_step,
+          m_options.bounds.min_lon + (col + 0.5 + 0.6 * jitter_lon) *
+                                         m_col_step};
+}
+
+NetworkWriter::location_t NetworkWriter::shape_node(
+    const bool horizontal, const uint64_t row, const uint64_t col,
+    const unsigned int index) const {
+  const location_t a = junction(row, col);
+  const location_t b =
+      horizontal ? junction(row, col + 1) : junction(row + 1, col);
+  const double t = (index + 1.0) / (m_options.shape_nodes + 1);
+  // Bow the segment sideways, as paths follow the ground rather than a ruler
+  const double amplitude =
+      0.3 * (hash_unit(m_options.seed, Wiggle, 2 * row + horizontal, col) -
+             0.5);
+  const double offset = amplitude * std::sin(M_PI * t);
+  const double dx = (b.second - a.second) * m_terrain.lon_to_m();
+  const double dy = (b.first - a.first) * m_terrain.lat_to_m();
+  return {a.first + t * (b.first - a.first) + offset * dx / m_terrain.lat_to_m(),
+          a.second + t * (b.second - a.second) -
+              offset * dy / m_terrain.lon_to_m()};
+}
+
+bool NetworkWriter::has_segment(const bool horizontal, const uint64_t row,
+                                const uint64_t col) const {
+  if (horizontal ? col + 1 >= m_cols : row + 1 >= m_rows) {
+    return false;
+  }
+  return hash_unit(m_options.seed, Segment, 2 * row + horizontal, col) <
+         (horizontal ? 0.85 : 0.7);
+}
+
+osmium::object_id_type NetworkWriter::junction_id(const uint64_t row,
+                                                  const uint64_t col) const {
+  return 1 + row * m_cols + col;
+}
+
+osmium::object_id_type NetworkWriter::shape_id(const bool horizontal,
+                                               const uint64_t row,
+                                               const uint64_t col,
+                                               const unsigned int index) const {
+  return m_shape_base[horizontal] +
+         (row * m_cols + col) * m_options.shape_nodes + index;
+}
+
+unsigned int NetworkWriter::water_size(const uint64_t water) const {
+  return 8 + hash_unit(m_options.seed, Water, water, 0) * (max_water_size - 8);
+}
+
+NetworkWriter::location_t NetworkWriter::water_node(
+    const uint64_t water, const unsigned int index) const {
+  const Bounds& b = m_options.bounds;
+  const uint64_t seed = m_options.seed;
+  // Keep a margin so polygons stay inside the map and the DEM
+  const double margin_lat = 200 / m_terrain.lat_to_m();
+  const double margin_lon = 200 / m_terrain.lon_to_m();
+  const double lat = b.min_lat + margin_lat +
+                     hash_unit(seed, Water, water, 1) *
+                         (b.max_lat - b.min_lat - 2 * margin_lat);
+  const double lon = b.min_lon + margin_lon +
+                     hash_unit(seed, Water, water, 2) *
+                         (b.max_lon - b.min_lon - 2 * margin_lon);
+  // Mostly small tarns, a few larger lakes
+  const double radius =
+      15 + 150 * std::pow(hash_unit(seed, Water, water, 3), 3);
+  const double angle = 2 * M_PI * index / water_size(water);
+  const double r =
+      radius * (0.75 + 0.5 * hash_unit(seed, Water, water, 4 + index));
+  return {lat + r * std::sin(angle) / m_terrain.lat_to_m(),
+          lon + r * std::cos(angle) / m_terrain.lon_to_m()};
+}
+
+NetworkWriter::tags_t NetworkWriter::way_tags(
+    const osmium::object_id_type way_id, const double slope) const {
+  const uint64_t seed = m_options.seed;
+  tags_t tags;
+  // Roughly the mix of a fell area: mostly paths and tracks, some roads
+  const double u = hash_unit(seed, Highway, way_id);
+  const char* highway = u < 0.45   ? "path"
+                        : u < 0.6  ? "footway"
+                        : u < 0.75 ? "track"
+                        : u < 0.8  ? "bridleway"
+                        : u < 0.87 ? "unclassified"
+                        : u < 0.93 ? "residential"
+                        : u < 0.96 ? "tertiary"
+                        : u < 0.98 ? "secondary"
+                        : u < 0.99 ? "primary"
+                                   : "trunk";
+  tags.emplace_back("highway", highway);
+
+  // Steeper ground gets harder sac_scale grades
+  if (u < 0.8) {
+    const double grade =
+        slope + 0.1 * (hash_unit(seed, Sac, way_id) - 0.5);
+    if (grade > 0.05) {
+      tags.emplace_back("sac_scale", grade < 0.12   ? "hiking"
+                                     : grade < 0.2  ? "mountain_hiking"
+                                     : grade < 0.3  ? "demanding_mountain_hiking"
+                                     : grade < 0.45 ? "alpine_hiking"
+                                                    : "demanding_alpine_hiking");
+    }
+  }
+
+  const double foot = hash_unit(seed, Foot, way_id);
+  if (foot < 0.1) {
+    tags.emplace_back("foot", "yes");
+  } else if (foot < 0.115) {
+    tags.emplace_back("foot", "no");
+  } else if (foot < 0.12) {
+    tags.emplace_back("foot", "private");
+  }
+  return tags;
+}
+
+void NetworkWriter::add_node(const osmium::object_id_type id,
+                             const location_t& location, const tags_t& tags) {
+  using namespace osmium::builder::attr;
+  osmium::builder::add_node(
+      m_buffer, _id(id), _version(1), _timestamp("2024-01-01T00:00:00Z"),
+      _location(osmium::Location(location.second, location.first)),
+      _tags(tags));
+  m_node_count++;
+  flush();
+}
+
+void NetworkWriter::add_way(const std::vector<osmium::object_id_type>& nodes,
+                            const tags_t& tags) {
+  using namespace osmium::builder::attr;
+  osmium::builder::add_way(m_buffer, _id(m_next_way++), _version(1),
+                           _timestamp("2024-01-01T00:00:00Z"), _nodes(nodes),
+                           _tags(tags));
+  m_way_count++;
+  flush();
+}
+
+void NetworkWriter::flush(const bool force) {
+  if (m_buffer.committed() > buffer_size * 3 / 4 ||
+      (force && m_buffer.committed() > 0)) {
+    (*m_writer)(std::move(m_buffer));
+    m_buffer = osmium::memory::Buffer(buffer_size,
+                                      osmium::memory::Buffer::auto_grow::yes);
+  }
+}
+
+// PBF readers expect nodes before ways, each in ascending id order, which
+// the id layout (junctions, shape nodes, water, peaks) gives directly
+void NetworkWriter::write_nodes() {
+  for (uint64_t row = 0; row < m_rows; row++) {
+    for (uint64_t col = 0; col < m_cols; col++) {
+      add_node(junction_id(row, col), junction(row, col));
+    }
+  }
+  for (const bool horizontal : {true, false}) {
+    for (uint64_t row = 0; row < m_rows; row++) {
+      for (uint64_t col = 0; col < m_cols; col++) {
+        if (!has_segment(horizontal, row, col)) continue;
+        for (unsigned int i = 0; i < m_options.shape_nodes; i++) {
+          add_node(shape_id(horizontal, row, col, i),
+                   shape_node(horizontal, row, col, i));
+        }
+      }
+    }
+  }
+  for (uint64_t water = 0; water < m_options.tarns; water++) {
+    for (unsigned int i = 0; i < water_size(water); i++) {
+      add_node(m_water_base + water * max_water_size + i,
+               water_node(water, i));
+    }
+  }
+
+  // Peaks are found by climbing the terrain from random points
+  const Bounds& b = m_options.bounds;
+  const double step_lat = 50 / m_terrain.lat_to_m();
+  const double step_lon = 50 / m_terrain.lon_to_m();
+  for (uint64_t peak = 0; peak < m_options.peaks; peak++) {
+    location_t location = {
+        b.min_lat + hash_unit(m_options.seed, Peak, peak, 0) *
+                        (b.max_lat - b.min_lat),
+        b.min_lon + hash_unit(m_options.seed, Peak, peak, 1) *
+                        (b.max_lon - b.min_lon)};
+    float elevation = m_terrain.elevation(location.first, location.second);
+    for (int step = 0; step < 200; step++) {
+      location_t best = location;
+      for (int dlat = -1; dlat <= 1; dlat++) {
+        for (int dlon = -1; dlon <= 1; dlon++) {
+          const location_t next = {location.first + dlat * step_lat,
+                                   location.second + dlon * step_lon};
+          if (next.first < b.min_lat || next.first > b.max_lat ||
+              next.second < b.min_lon || next.second > b.max_lon) {
+            continue;
+          }
+          const float next_elevation =
+              m_terrain.elevation(next.first, next.second);
+          if (next_elevation > elevation) {
+            elevation = next_elevation;
+            best = next;
+          }
+        }
+      }
+      if (best == location) break;
+      location = best;
+    }
+    add_node(m_peak_base + peak, location,
+             {{"natural", "peak"},
+              {"name", "Peak " + std::to_string(peak)},
+              {"ele", std::to_string(std::lround(elevation))}});
+  }
+}
+
+// Joins consecutive lattice segments along a row (or column) into ways of a
+// few segments each, so junctions shared by several ways split the edges
+void NetworkWriter::write_ways(const bool horizontal) {
+  const uint64_t lines = horizontal ? m_rows : m_cols;
+  const uint64_t length = horizontal ? m_cols : m_rows;
+  std::vector<osmium::object_id_type> nodes;
+  location_t first;
+
+  auto finish_way = [&](const location_t& last) {
+    if (nodes.size() >= 2) {
+      const double dx = (last.second - first.second) * m_terrain.lon_to_m();
+      const double dy = (last.first - first.first) * m_terrain.lat_to_m();
+      const double distance = std::max(1.0, std::sqrt(dx * dx + dy * dy));
+      const double slope =
+          std::abs(m_terrain.elevation(last.first, last.second) -
+                   m_terrain.elevation(first.first, first.second)) /
+          distance;
+      add_way(nodes, way_tags(m_next_way, slope));
+    }
+    nodes.clear();
+  };
+
+  for (uint64_t line = 0; line < lines; line++) {
+    for (uint64_t step = 0; step + 1 < length; step++) {
+      const uint64_t row = horizontal ? line : step;
+      const uint64_t col = horizontal ? step : line;
+      if (!has_segment(horizontal, row, col)) {
+        finish_way(junction(row, col));
+        continue;
+      }
+      if (nodes.empty()) {
+        nodes.push_back(junction_id(row, col));
+        first = junction(row, col);
+      }
+      for (unsigned int i = 0; i < m_options.shape_nodes; i++) {
+        nodes.push_back(shape_id(horizontal, row, col, i));
+      }
+      const uint64_t next_row = horizontal ? row : row + 1;
+      const uint64_t next_col = horizontal ? col + 1 : col;
+      nodes.push_back(junction_id(next_row, next_col));
+      if (hash_unit(m_options.seed, Split, 2 * row + horizontal, col) < 0.35) {
+        finish_way(junction(next_row, next_col));
+      }
+    }
+    const uint64_t last_row = horizontal ? line : length - 1;
+    const uint64_t last_col = horizontal ? length - 1 : line;
+    finish_way(junction(last_row, last_col));
+  }
+}
+
+void NetworkWriter::write_water() {
+  std::vector<osmium::object_id_type> nodes;
+  for (uint64_t water = 0; water < m_options.tarns; water++) {
+    nodes.clear();
+    for (unsigned int i = 0; i < water_size(water); i++) {
+      nodes.push_back(m_water_base + water * max_water_size + i);
+    }
+    nodes.push_back(nodes.front());  // Closed ring
+
+    // Named tarns and lakes, with some unnamed ponds and river areas that
+    // OSMParser has to skip
+    const double u = hash_unit(m_options.seed, Water, water, 100);
+    tags_t tags = {{"natural", "water"}};
+    if (u < 0.85) {
+      tags.emplace_back("name", "Tarn " + std::to_string(water));
+      if (u < 0.45) {
+        tags.emplace_back("water", "pond");
+      } else if (u < 0.7) {
+        tags.emplace_back("water", "lake");
+      }
+    } else if (u < 0.92) {
+      tags.emplace_back("water", "river");
+      tags.emplace_back("name", "Beck " + std::to_string(water));
+    }
+    add_way(nodes, tags);
+  }
+}
+
+bool NetworkWriter::write_pbf(const std::string& filename) {
+  const Bounds& b = m_options.bounds;
+  osmium::io::Header header;
+  header.set("generator", "SyntheticMap");
+  header.add_box(osmium::Box(b.min_lon, b.min_lat, b.max_lon, b.max_lat));
+
+  try {
+    osmium::io::Writer writer(filename, header, osmium::io::overwrite::allow);
+    m_writer = &writer;
+    write_nodes();
+    write_ways(true);
+    write_ways(false);
+    write_water();
+    flush(true);
+    writer.close();
+  } catch (const std::exception& e) {
+    std::cerr << "Failed to write " << filename << ": " << e.what()
+              << std::endl;
+    m_writer = nullptr;
+    return false;
+  }
+  m_writer = nullptr;
+
+  std::cout << "Wrote " << m_node_count << " nodes and " << m_way_count
+            << " ways (" << m_rows << "x" << m_cols << " lattice, "
+            << m_options.tarns << " water bodies, " << m_options.peaks
+            << " peaks) to " << filename << std::endl;
+  return true;
+}
+
+}  // namespace synthmap
@@ -0,0 +1,96 @@
+#include <getopt.h>
+#include <chrono>
+#include <cstdio>
+#include "generator.hh"
+
+// Writes a reproducible OSM extract and DEM of any size for OSMParser, so
+// the whole pipeline can be profiled beyond the size of the real map.
+
+namespace {
+
+void usage(const char* name) {
+  std::cerr << "Usage: " << name
+            << " [--nodes <n>] [--seed <n>] [--tarns <n>] [--peaks <n>]"
+               " [--shape-nodes <n>] [--dem-resolution <m>]"
+               " [--bounds <min_lat,max_lat,min_lon,max_lon>]"
+               " <out.osm.pbf> <out.tif>"
+            << std::endl;
+  exit(1);
+}
+
+void handle_option(int argc, char** argv, synthmap::Options& options,
+                   std::string& osm_filename, std::string& elevation_filename) {
+  const option long_options[] = {
+      {"nodes", required_argument, nullptr, 'n'},
+      {"seed", required_argument, nullptr, 's'},
+      {"tarns", required_argument, nullptr, 't'},
+      {"peaks", required_argument, nullptr, 'p'},
+      {"shape-nodes", required_argument, nullptr, 'k'},
+      {"dem-resolution", required_argument, nullptr, 'r'},
+      {"bounds", required_argument, nullptr, 'b'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "n:s:t:p:k:r:b:", long_options,
+                            nullptr)) != -1) {
+    switch (opt) {
+      case 'n':
+        options.nodes = std::stoull(optarg);
+        break;
+      case 's':
+        options.seed = std::stoull(optarg);
+        break;
+      case 't':
+        options.tarns = std::stoull(optarg);
+        break;
+      case 'p':
+        options.peaks = std::stoull(optarg);
+        break;
+      case 'k':
+        options.shape_nodes = std::stoul(optarg);
+        break;
+      case 'r':
+        options.dem_resolution = std::stod(optarg);
+        break;
+      case 'b': {
+        synthmap::Bounds& b = options.bounds;
+        if (sscanf(optarg, "%lf,%lf,%lf,%lf", &b.min_lat, &b.max_lat,
+                   &b.min_lon, &b.max_lon) != 4 ||
+            b.min_lat >= b.max_lat || b.min_lon >= b.max_lon) {
+          std::cerr << "Invalid bounds " << optarg << std::endl;
+          exit(1);
+        }
+        break;
+      }
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2) {
+    usage(argv[0]);
+  }
+  osm_filename = argv[optind];
+  elevation_filename = argv[optind + 1];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  synthmap::Options options;
+  std::string osm_filename, elevation_filename;
+  handle_option(argc, argv, options, osm_filename, elevation_filename);
+
+  const auto start = std::chrono::steady_clock::now();
+  const synthmap::Terrain terrain(options.bounds, options.seed);
+  if (!terrain.write_geotiff(elevation_filename, options.dem_resolution)) {
+    return 1;
+  }
+  synthmap::NetworkWriter writer(options, terrain);
+  if (!writer.write_pbf(osm_filename)) {
+    return 1;
+  }
+  std::cout << "Generated in "
+            << std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " s" << std::endl;
+}